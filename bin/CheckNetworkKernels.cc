@@ -0,0 +1,116 @@
+#include "lwtnn/LightweightGraph.hh"
+#include "lwtnn/LightweightNeuralNetwork.hh"
+#include "lwtnn/parse_json.hh"
+
+#include <boost/program_options.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+
+#include "HiggsAnalysis/friend-tree-producer/interface/GeneratedNetwork.h"
+
+namespace po = boost::program_options;
+
+// Compares the network kernels generated by generate_network_kernels.py and compiled into this executable
+// with lwtnn, evaluated on the lwtnn config each kernel was generated from, for random inputs.
+// Kernels, whose config changed after the generation, show up as inconsistent.
+int main(int argc, char** argv)
+{
+  std::vector<std::string> kernels = {};
+  unsigned int check_events = 1000;
+  double tolerance = 1e-10;
+
+  po::variables_map vm;
+  po::options_description config("configuration");
+  config.add_options()
+    ("kernels", po::value<std::vector<std::string>>(&kernels)->multitoken(), "names of the kernels to check, all generated kernels if not given")
+    ("check_events", po::value<unsigned int>(&check_events)->default_value(check_events))
+    ("tolerance", po::value<double>(&tolerance)->default_value(tolerance), "maximal relative deviation of the outputs of the generated kernels");
+  po::store(po::command_line_parser(argc, argv).options(config).run(), vm);
+  po::notify(vm);
+
+  if(kernels.size() == 0)
+  {
+    for(const auto& kernel : generated_kernels()) kernels.push_back(kernel.first);
+  }
+  if(kernels.size() == 0)
+  {
+    std::cout << "No generated kernels available. Please generate them with generate_network_kernels.py and recompile." << std::endl;
+    return 1;
+  }
+
+  int failed = 0;
+  for(const auto& name : kernels)
+  {
+    auto kernel = generated_kernels().find(name);
+    if(kernel == generated_kernels().end())
+    {
+      std::cout << "Kernel " << name << " not found among the generated kernels" << std::endl;
+      failed++;
+      continue;
+    }
+    const GeneratedKernel& generated = kernel->second;
+    GeneratedNetwork network(name);
+    Eigen::MatrixXd test_inputs = 3.0 * Eigen::MatrixXd::Random(network.n_inputs(), check_events);
+    Eigen::MatrixXd outputs, lwtnn_outputs(network.n_outputs(), check_events);
+
+    auto start = std::chrono::steady_clock::now();
+    network.compute(test_inputs, outputs);
+    const double kernel_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Evaluate lwtnn event by event, with the inputs of a graph split into its input nodes
+    boost::property_tree::ptree config_json;
+    std::ifstream config_file(generated.source);
+    if(!config_file)
+    {
+      std::cout << "Could not read " << generated.source << ", the config of kernel " << name << std::endl;
+      failed++;
+      continue;
+    }
+    boost::property_tree::json_parser::read_json(config_file, config_json);
+    config_file.clear();
+    config_file.seekg(0);
+    start = std::chrono::steady_clock::now();
+    if(config_json.count("nodes") > 0)
+    {
+      const lwt::GraphConfig graph_config = lwt::parse_json_graph(config_file);
+      lwt::LightweightGraph graph(graph_config, generated.output_node);
+      std::map<std::string, std::map<std::string, double>> inputs;
+      for(unsigned int k = 0; k < check_events; k++)
+      {
+        size_t row = 0;
+        for(const auto& input_node : graph_config.inputs)
+        {
+          for(const auto& variable : input_node.variables) inputs[input_node.name][variable.name] = test_inputs(row++, k);
+        }
+        auto values = graph.compute(inputs, generated.output_node);
+        for(size_t o = 0; o < network.n_outputs(); o++) lwtnn_outputs(o, k) = values[network.output_labels()[o]];
+      }
+    }
+    else
+    {
+      const lwt::JSONConfig sequential_config = lwt::parse_json(config_file);
+      lwt::LightweightNeuralNetwork sequential(sequential_config.inputs, sequential_config.layers, sequential_config.outputs);
+      std::map<std::string, double> inputs;
+      for(unsigned int k = 0; k < check_events; k++)
+      {
+        for(size_t i = 0; i < network.n_inputs(); i++) inputs[network.input_names()[i]] = test_inputs(i, k);
+        auto values = sequential.compute(inputs);
+        for(size_t o = 0; o < network.n_outputs(); o++) lwtnn_outputs(o, k) = values[network.output_labels()[o]];
+      }
+    }
+    const double lwtnn_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const double deviation = ((outputs - lwtnn_outputs).array().abs() / lwtnn_outputs.array().abs().max(1e-30)).maxCoeff();
+    const bool consistent = deviation <= tolerance;
+    std::cout << (consistent ? "Consistent " : "Inconsistent ") << name << " with " << generated.source << " (" << network.n_inputs() << " inputs, "
+              << network.n_outputs() << " outputs, maximal deviation " << deviation << ", " << 1e6 * kernel_time / check_events << " us per event vs. "
+              << 1e6 * lwtnn_time / check_events << " us with lwtnn)" << std::endl;
+    if(!consistent) failed++;
+  }
+  return failed > 0 ? 1 : 0;
+}
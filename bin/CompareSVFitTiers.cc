@@ -0,0 +1,149 @@
+#include "TFile.h"
+#include "TTree.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+
+#include "HiggsAnalysis/friend-tree-producer/interface/Benchmark.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/FriendTreeRunner.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/HelperFunctions.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/SVFitProducer.h"
+
+namespace fs = boost::filesystem;
+namespace po = boost::program_options;
+
+// Values of a Float_t branch of the input tree in the entry range of the task, or an empty list if the branch does not exist
+std::vector<double> read_input_branch(const ProducerTask& task, const std::string& branch)
+{
+  std::vector<double> values;
+  TFile* file = TFile::Open(task.input.c_str(), "read");
+  if(!file || file->IsZombie()) throw std::runtime_error("Could not open " + task.input + ".");
+  TTree* tree = (TTree*) file->Get((task.folder + "/" + task.tree).c_str());
+  if(tree->GetBranch(branch.c_str()))
+  {
+    Float_t value = 0.0;
+    tree->SetBranchStatus("*", 0);
+    tree->SetBranchStatus(branch.c_str(), 1);
+    tree->SetBranchAddress(branch.c_str(), &value);
+    for(Long64_t entry = task.first_entry; entry <= task.last_entry; entry++)
+    {
+      tree->GetEntry(entry);
+      values.push_back(value);
+    }
+  }
+  file->Close();
+  return values;
+}
+
+// Relative resolution of the reconstructed mass: half the width of the central 68% interval of the ratio
+// to the true mass, divided by its median. Events without valid solution or true mass are skipped.
+double mass_resolution(const std::vector<double>& masses, const std::vector<double>& truth)
+{
+  std::vector<double> ratios;
+  for(size_t k = 0; k < masses.size(); k++)
+  {
+    if(masses[k] > 0.0 && truth[k] > 0.0) ratios.push_back(masses[k] / truth[k]);
+  }
+  const double median = quantile(ratios, 0.5);
+  if(median <= 0.0) return 0.0;
+  return 0.5 * (quantile(ratios, 0.84) - quantile(ratios, 0.16)) / median;
+}
+
+// Runs ClassicSVfit with the default tier and each further tier on a single read of a reference ntuple, and reports
+// the m_sv resolution of each tier and its loss with respect to the default tier, the per-event deviation of m_sv
+// from the default tier and the compute time. The resolution is determined with respect to the true mass in --truth
+// and is omitted, if the reference ntuple has no such branch.
+int main(int argc, char** argv)
+{
+  std::string input = "output.root";
+  std::vector<std::string> input_friends = {};
+  std::string folder = "mt_nominal";
+  std::string tree = "ntuple";
+  unsigned int first_entry = 0;
+  unsigned int last_entry = 999;
+  unsigned int block_size = 100;
+  unsigned int threads = 1;
+  std::string work_dir = "svfit_tiers";
+  std::vector<std::string> tiers = {"balanced", "fast", "fastest", "precise"};
+  std::string met_prefix = "";
+  std::string truth = "genbosonmass";
+
+  po::variables_map vm;
+  po::options_description config("configuration");
+  config.add_options()
+    ("input", po::value<std::string>(&input)->default_value(input), "reference ntuple")
+    ("input_friends", po::value<std::vector<std::string>>(&input_friends)->multitoken())
+    ("folder", po::value<std::string>(&folder)->default_value(folder))
+    ("tree", po::value<std::string>(&tree)->default_value(tree))
+    ("first_entry", po::value<unsigned int>(&first_entry)->default_value(first_entry))
+    ("last_entry", po::value<unsigned int>(&last_entry)->default_value(last_entry))
+    ("block_size", po::value<unsigned int>(&block_size)->default_value(block_size))
+    ("threads", po::value<unsigned int>(&threads)->default_value(threads))
+    ("work_dir", po::value<std::string>(&work_dir)->default_value(work_dir))
+    ("tiers", po::value<std::vector<std::string>>(&tiers)->multitoken(), "tiers to compare with the default tier")
+    ("met_prefix", po::value<std::string>(&met_prefix)->default_value(met_prefix), "MET definition used for ClassicSVfit, e.g. puppi")
+    ("truth", po::value<std::string>(&truth)->default_value(truth), "branch with the true di-tau mass");
+  po::store(po::command_line_parser(argc, argv).options(config).run(), vm);
+  po::notify(vm);
+
+  // One producer per tier, run on the same read of the input
+  std::vector<std::string> all_tiers = {"default"};
+  all_tiers.insert(all_tiers.end(), tiers.begin(), tiers.end());
+  const std::string computation = met_prefix != "" ? "sv:" + met_prefix : "sv";
+  std::vector<std::unique_ptr<FriendProducer>> producers;
+  std::vector<std::unique_ptr<TimedProducer>> timed_producers;
+  std::vector<FriendProducer*> producer_pointers;
+  std::vector<std::string> outputnames;
+  for(const auto& tier : all_tiers)
+  {
+    producers.emplace_back(new SVFitProducer(threads, "", {computation}, tier));
+    timed_producers.emplace_back(new TimedProducer(*producers.back()));
+    producer_pointers.push_back(timed_producers.back().get());
+    outputnames.push_back(outputname_from_settings(input, folder, first_entry, last_entry, fs::path(work_dir) / tier));
+  }
+  ProducerTask task = {input, input_friends, folder, tree, first_entry, last_entry};
+  run_producers(producer_pointers, outputnames, task, block_size);
+
+  // Compare m_sv of each tier with the default tier
+  const std::string branch = "m_" + parse_svfit_computation(computation).suffix();
+  const std::vector<double> truth_masses = read_input_branch(task, truth);
+  if(truth_masses.size() == 0) std::cout << "Branch " << truth << " not found in the input, the resolution is not determined." << std::endl;
+  std::vector<std::vector<double>> masses;
+  for(const auto& outputname : outputnames) masses.push_back(read_branches(outputname, folder).at(branch));
+  const double default_resolution = truth_masses.size() > 0 ? mass_resolution(masses[0], truth_masses) : 0.0;
+
+  std::cout << std::left << std::setw(10) << "tier" << std::right << std::setw(12) << "valid" << std::setw(14) << "resolution" << std::setw(10) << "loss"
+            << std::setw(16) << "mean |rel diff|" << std::setw(14) << "median" << std::setw(14) << "p95" << std::setw(14) << "compute [s]" << std::setw(10) << "speedup" << std::endl;
+  for(size_t t = 0; t < all_tiers.size(); t++)
+  {
+    // Relative deviation from the default tier for events with valid solution in both tiers
+    std::vector<double> deviations;
+    double mean = 0.0;
+    size_t valid = 0;
+    for(size_t k = 0; k < masses[t].size(); k++)
+    {
+      if(masses[t][k] > 0.0) valid++;
+      if(masses[t][k] > 0.0 && masses[0][k] > 0.0) deviations.push_back(std::fabs(masses[t][k] - masses[0][k]) / masses[0][k]);
+    }
+    for(const auto& deviation : deviations) mean += deviation / deviations.size();
+
+    std::cout << std::left << std::setw(10) << all_tiers[t] << std::right << std::setw(12) << valid;
+    if(truth_masses.size() > 0)
+    {
+      const double resolution = mass_resolution(masses[t], truth_masses);
+      std::cout << std::fixed << std::setprecision(4) << std::setw(14) << resolution << std::setprecision(1) << std::setw(9)
+                << 100.0 * (resolution / std::max(default_resolution, 1e-9) - 1.0) << "%";
+    }
+    else std::cout << std::setw(14) << "-" << std::setw(10) << "-";
+    const double seconds = timed_producers[t]->compute_seconds();
+    std::cout << std::scientific << std::setprecision(3) << std::setw(16) << mean << std::setw(14) << quantile(deviations, 0.5) << std::setw(14) << quantile(deviations, 0.95)
+              << std::fixed << std::setprecision(2) << std::setw(14) << seconds << std::setw(10) << timed_producers[0]->compute_seconds() / std::max(seconds, 1e-9) << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,131 @@
+#include "lwtnn/LightweightGraph.hh"
+#include "lwtnn/LightweightNeuralNetwork.hh"
+#include "lwtnn/parse_json.hh"
+
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+
+#include "HiggsAnalysis/friend-tree-producer/interface/DenseNetwork.h"
+
+namespace fs = boost::filesystem;
+namespace po = boost::program_options;
+
+// Compiles lwtnn json configs into the binary format of DenseNetwork, written next to each config <name>.json as <name>.dnn.
+// Directories are searched recursively for *_lwtnn.json files. Each compiled network is loaded again and
+// compared with lwtnn, evaluated on the json file, for random inputs.
+int main(int argc, char** argv)
+{
+  std::vector<std::string> inputs = {};
+  std::string output_node = "";
+  unsigned int check_events = 1000;
+  double tolerance = 1e-10;
+
+  po::variables_map vm;
+  po::options_description config("configuration");
+  config.add_options()
+    ("inputs", po::value<std::vector<std::string>>(&inputs)->multitoken()->required(), "lwtnn json configs or directories with *_lwtnn.json configs")
+    ("output_node", po::value<std::string>(&output_node)->default_value(output_node), "output node of graph configs, if they have more than one")
+    ("check_events", po::value<unsigned int>(&check_events)->default_value(check_events))
+    ("tolerance", po::value<double>(&tolerance)->default_value(tolerance), "maximal relative deviation of the outputs of the compiled network");
+  po::store(po::command_line_parser(argc, argv).options(config).run(), vm);
+  po::notify(vm);
+
+  std::vector<std::string> configs;
+  for(const auto& input : inputs)
+  {
+    if(fs::is_directory(input))
+    {
+      for(const auto& entry : fs::recursive_directory_iterator(input))
+      {
+        const std::string filename = entry.path().filename().string();
+        if(filename.size() > 11 && filename.compare(filename.size() - 11, 11, "_lwtnn.json") == 0) configs.push_back(entry.path().string());
+      }
+    }
+    else configs.push_back(input);
+  }
+  std::sort(configs.begin(), configs.end());
+
+  int failed = 0;
+  for(const auto& lwtnn_json : configs)
+  {
+    // Graph configs have a list of nodes, sequential configs only layers
+    boost::property_tree::ptree config_json;
+    boost::property_tree::json_parser::read_json(lwtnn_json, config_json);
+    std::ifstream config_file(lwtnn_json);
+    const bool is_graph = config_json.count("nodes") > 0;
+    lwt::GraphConfig graph_config;
+    lwt::JSONConfig sequential_config;
+    std::string node = output_node;
+    std::unique_ptr<DenseNetwork> network;
+    if(is_graph)
+    {
+      graph_config = lwt::parse_json_graph(config_file);
+      if(node == "" && graph_config.outputs.size() == 1) node = graph_config.outputs.begin()->first;
+      if(node == "")
+      {
+        std::cout << "Skipping " << lwtnn_json << ", since it has several output nodes and no --output_node is given" << std::endl;
+        failed++;
+        continue;
+      }
+      network.reset(new DenseNetwork(graph_config, node));
+    }
+    else
+    {
+      sequential_config = lwt::parse_json(config_file);
+      network.reset(new DenseNetwork(sequential_config));
+    }
+
+    const std::string compiled = compiled_network_path(lwtnn_json);
+    network->save(compiled);
+
+    // Compare the compiled network with lwtnn, evaluated event by event, with the inputs of a graph split into its input nodes
+    std::unique_ptr<DenseNetwork> loaded = DenseNetwork::load(compiled);
+    Eigen::MatrixXd test_inputs = 3.0 * Eigen::MatrixXd::Random(loaded->n_inputs(), check_events);
+    Eigen::MatrixXd outputs, lwtnn_outputs(loaded->n_outputs(), check_events);
+    loaded->compute(test_inputs, outputs);
+    if(is_graph)
+    {
+      lwt::LightweightGraph graph(graph_config, node);
+      std::map<std::string, std::map<std::string, double>> inputs;
+      for(unsigned int k = 0; k < check_events; k++)
+      {
+        size_t row = 0;
+        for(const auto& input_node : graph_config.inputs)
+        {
+          for(const auto& variable : input_node.variables) inputs[input_node.name][variable.name] = test_inputs(row++, k);
+        }
+        auto values = graph.compute(inputs, node);
+        for(size_t o = 0; o < loaded->n_outputs(); o++) lwtnn_outputs(o, k) = values[loaded->output_labels()[o]];
+      }
+    }
+    else
+    {
+      lwt::LightweightNeuralNetwork sequential(sequential_config.inputs, sequential_config.layers, sequential_config.outputs);
+      std::map<std::string, double> inputs;
+      for(unsigned int k = 0; k < check_events; k++)
+      {
+        for(size_t i = 0; i < loaded->n_inputs(); i++) inputs[loaded->input_names()[i]] = test_inputs(i, k);
+        auto values = sequential.compute(inputs);
+        for(size_t o = 0; o < loaded->n_outputs(); o++) lwtnn_outputs(o, k) = values[loaded->output_labels()[o]];
+      }
+    }
+    const double deviation = ((outputs - lwtnn_outputs).array().abs() / lwtnn_outputs.array().abs().max(1e-30)).maxCoeff();
+    const bool consistent = loaded->input_names() == network->input_names() && loaded->output_labels() == network->output_labels() && deviation <= tolerance;
+    std::cout << (consistent ? "Compiled " : "Inconsistent ") << lwtnn_json << " into " << compiled << " (" << network->n_inputs() << " inputs, "
+              << network->n_outputs() << " outputs, " << fs::file_size(compiled) / 1024 << " kB, maximal deviation from lwtnn " << deviation << ")" << std::endl;
+    if(!consistent)
+    {
+      fs::remove(compiled);
+      failed++;
+    }
+  }
+  return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,133 @@
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/program_options.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+
+#include "HiggsAnalysis/friend-tree-producer/interface/HelperFunctions.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/FriendTreeRunner.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/TaskQueue.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/CorrectionWeightsProducer.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/MELAProducer.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/NNMassProducer.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/NNScoreProducer.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/NNrecoilProducer.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/SVFitProducer.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/ZPtMReweightingProducer.h"
+
+using boost::starts_with;
+namespace po = boost::program_options;
+
+// Runs several friend tree producers on a single read of the input tree.
+// The friend tree of each producer is written to <output_dir>/<producer>/<input>/<input>_<folder>_<first_entry>_<last_entry>.root
+int main(int argc, char** argv)
+{
+  std::string input = "output.root";
+  std::vector<std::string> input_friends = {};
+  std::string output_dir = "";
+  std::string folder = "mt_nominal";
+  std::string tree = "ntuple";
+  std::vector<std::string> producer_names = {};
+  unsigned int first_entry = 0;
+  unsigned int last_entry = 9;
+  unsigned int block_size = 1000;
+
+  // Options of the individual producers. The option lwtnn_config is used by NNMass,
+  // nn_lwtnn_config is the directory of the NNScore and NNrecoil models.
+  // weights_config lists the weights of CorrectionWeights, with files relative to the data directory.
+  // mela_workers is the number of forked MELA processes, with 0 running MELA in the main process.
+  // svfit_computations are the algorithms and MET definitions of SVFit, as for the computations option of SVFit.
+  // svfit_tier is the accuracy/speed tier of the ClassicSVfit integration, as for the tier option of SVFit.
+  // preselection is the expression of input branches selecting the events computed by SVFit and MELA.
+  unsigned int threads = 1;
+  unsigned int mela_workers = 0;
+  std::string cache_dir = "";
+  std::vector<std::string> svfit_computations = default_svfit_computations();
+  std::string svfit_tier = "default";
+  std::string preselection = "";
+  std::string lwtnn_config = "model.json";
+  std::string nn_lwtnn_config = std::string(std::getenv("CMSSW_BASE"))+"/src/HiggsAnalysis/friend-tree-producer/data/inputs_lwtnn/";
+  std::string datasets = std::string(std::getenv("CMSSW_BASE"))+"/src/HiggsAnalysis/friend-tree-producer/data/input_params/datasets.json";
+  std::string weight_directory = std::string(std::getenv("CMSSW_BASE"))+"/src/HiggsAnalysis/friend-tree-producer/data/zptm_reweighting/";
+  std::string weights_config = std::string(std::getenv("CMSSW_BASE"))+"/src/HiggsAnalysis/friend-tree-producer/data/correction_weights.json";
+  std::string data_directory = std::string(std::getenv("CMSSW_BASE"))+"/src/HiggsAnalysis/friend-tree-producer/data/";
+
+  WriterSettings writer_settings;
+  ReaderSettings reader_settings;
+  PipelineSettings pipeline_settings;
+  TaskQueueSettings queue_settings;
+  NetworkSettings network_settings;
+  po::variables_map vm;
+  po::options_description config("configuration");
+  config.add_options()
+    ("input", po::value<std::string>(&input)->default_value(input))
+    ("input_friends", po::value<std::vector<std::string>>(&input_friends)->multitoken())
+    ("output_dir", po::value<std::string>(&output_dir)->default_value(output_dir))
+    ("folder", po::value<std::string>(&folder)->default_value(folder))
+    ("tree", po::value<std::string>(&tree)->default_value(tree))
+    ("first_entry", po::value<unsigned int>(&first_entry)->default_value(first_entry))
+    ("last_entry", po::value<unsigned int>(&last_entry)->default_value(last_entry))
+    ("block_size", po::value<unsigned int>(&block_size)->default_value(block_size))
+    ("producers", po::value<std::vector<std::string>>(&producer_names)->multitoken()->required())
+    ("threads", po::value<unsigned int>(&threads)->default_value(threads))
+    ("mela_workers", po::value<unsigned int>(&mela_workers)->default_value(mela_workers))
+    ("cache_dir", po::value<std::string>(&cache_dir)->default_value(cache_dir))
+    ("svfit_computations", po::value<std::vector<std::string>>(&svfit_computations)->multitoken())
+    ("svfit_tier", po::value<std::string>(&svfit_tier)->default_value(svfit_tier))
+    ("preselection", po::value<std::string>(&preselection)->default_value(preselection))
+    ("lwtnn_config", po::value<std::string>(&lwtnn_config)->default_value(lwtnn_config))
+    ("nn_lwtnn_config", po::value<std::string>(&nn_lwtnn_config)->default_value(nn_lwtnn_config))
+    ("datasets", po::value<std::string>(&datasets)->default_value(datasets))
+    ("weights_config", po::value<std::string>(&weights_config)->default_value(weights_config));
+  add_writer_options(config, writer_settings);
+  add_reader_options(config, reader_settings);
+  add_pipeline_options(config, pipeline_settings);
+  add_task_queue_options(config, queue_settings);
+  add_network_options(config, network_settings);
+  po::store(po::command_line_parser(argc, argv).options(config).run(), vm);
+  po::notify(vm);
+
+  // Set up the requested producers
+  std::vector<std::unique_ptr<FriendProducer>> producers;
+  for(const auto& producer_name : producer_names)
+  {
+    auto init_start = std::chrono::steady_clock::now();
+    if(producer_name == "SVFit") producers.emplace_back(new SVFitProducer(threads, cache_dir, svfit_computations, svfit_tier, preselection));
+    else if(producer_name == "MELA") producers.emplace_back(new MELAProducer(cache_dir, mela_workers, preselection));
+    else if(producer_name == "NNMass") producers.emplace_back(new NNMassProducer(lwtnn_config, network_settings));
+    else if(producer_name == "NNScore") producers.emplace_back(new NNScoreProducer(nn_lwtnn_config, datasets, network_settings));
+    else if(producer_name == "NNrecoil") producers.emplace_back(new NNrecoilProducer(nn_lwtnn_config, network_settings));
+    else if(producer_name == "ZPtMReweighting") producers.emplace_back(new ZPtMReweightingProducer(datasets, weight_directory));
+    else if(producer_name == "CorrectionWeights") producers.emplace_back(new CorrectionWeightsProducer(read_correction_weights(weights_config), datasets, data_directory));
+    else
+    {
+      std::cout << "Producer " << producer_name << " not available in CompositeProducer. Exiting" << std::endl;
+      return 1;
+    }
+    init_times()[producer_name] = seconds_since(init_start);
+  }
+
+  // Run all producers on the desired events of the input tree, or on all tasks of the task file or spool directory
+  std::vector<FriendProducer*> producer_pointers;
+  for(const auto& producer : producers) producer_pointers.push_back(producer.get());
+  auto outputnames = [&](const ProducerTask& task)
+  {
+    std::vector<std::string> names;
+    for(const auto& producer : producers)
+    {
+      names.push_back(outputname_from_settings(task.input, task.folder, task.first_entry, task.last_entry, fs::path(output_dir) / producer->name()));
+    }
+    return names;
+  };
+  if(queue_settings.enabled())
+  {
+    return run_task_queue(producer_pointers, outputnames, queue_settings, tree, block_size, writer_settings, reader_settings, pipeline_settings) > 0;
+  }
+  ProducerTask task = {input, input_friends, folder, tree, first_entry, last_entry};
+  run_producers(producer_pointers, outputnames(task), task, block_size, writer_settings, reader_settings, pipeline_settings);
+
+  return 0;
+}
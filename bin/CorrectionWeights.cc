@@ -0,0 +1,73 @@
+#include <boost/algorithm/string.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/program_options.hpp>
+#include <boost/regex.hpp>
+
+#include <chrono>
+#include <iostream>
+
+#include "HiggsAnalysis/friend-tree-producer/interface/HelperFunctions.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/FriendTreeRunner.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/TaskQueue.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/CorrectionWeightsProducer.h"
+
+using boost::starts_with;
+namespace po = boost::program_options;
+
+int main(int argc, char **argv) {
+  std::string input = "output.root";
+  std::vector<std::string> input_friends  = {};
+  std::string folder = "mt_nominal";
+  std::string tree = "ntuple";
+  std::string weights_config = std::string(std::getenv("CMSSW_BASE"))+"/src/HiggsAnalysis/friend-tree-producer/data/correction_weights.json";
+  std::string datasets = std::string(std::getenv("CMSSW_BASE"))+"/src/HiggsAnalysis/friend-tree-producer/data/input_params/datasets.json";
+  std::string weight_directory = std::string(std::getenv("CMSSW_BASE"))+"/src/HiggsAnalysis/friend-tree-producer/data/";
+  unsigned int first_entry = 0;
+  unsigned int last_entry = 9;
+  unsigned int block_size = 1000;
+  WriterSettings writer_settings;
+  ReaderSettings reader_settings;
+  PipelineSettings pipeline_settings;
+  TaskQueueSettings queue_settings;
+  po::variables_map vm;
+  po::options_description config("configuration");
+  config.add_options()
+     ("input",            po::value<std::string>(&input)->default_value(input))
+     ("input_friends",    po::value<std::vector<std::string>>(&input_friends)->multitoken())
+     ("folder",           po::value<std::string>(&folder)->default_value(folder))
+     ("tree",             po::value<std::string>(&tree)->default_value(tree))
+     ("first_entry",      po::value<unsigned int>(&first_entry)->default_value(first_entry))
+     ("last_entry",       po::value<unsigned int>(&last_entry)->default_value(last_entry))
+     ("block_size",       po::value<unsigned int>(&block_size)->default_value(block_size))
+     ("weights_config",   po::value<std::string>(&weights_config)->default_value(weights_config))
+     ("weight_directory", po::value<std::string>(&weight_directory)->default_value(weight_directory))
+     ("datasets",         po::value<std::string>(&datasets)->default_value(datasets));
+  add_writer_options(config, writer_settings);
+  add_reader_options(config, reader_settings);
+  add_pipeline_options(config, pipeline_settings);
+  add_task_queue_options(config, queue_settings);
+  po::store(po::command_line_parser(argc, argv).options(config).run(), vm);
+  po::notify(vm);
+
+  // Determine all configured weights for the desired events of the input tree
+  auto init_start = std::chrono::steady_clock::now();
+  CorrectionWeightsProducer producer(read_correction_weights(weights_config), datasets, weight_directory);
+  init_times()[producer.name()] = seconds_since(init_start);
+  if (queue_settings.enabled()) {
+    // Process all tasks of the task file or spool directory with the same producer
+    auto outputnames = [](const ProducerTask &task) {
+      return std::vector<std::string>{outputname_from_settings(
+          task.input, task.folder, task.first_entry, task.last_entry)};
+    };
+    return run_task_queue({&producer}, outputnames, queue_settings, tree,
+                          block_size, writer_settings, reader_settings, pipeline_settings) > 0;
+  }
+  ProducerTask task = {input, input_friends, folder, tree, first_entry, last_entry};
+  auto outputname =
+      outputname_from_settings(input, folder, first_entry, last_entry);
+  run_producers({&producer}, {outputname}, task, block_size, writer_settings, reader_settings, pipeline_settings);
+
+  return 0;
+}
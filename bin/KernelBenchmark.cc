@@ -0,0 +1,192 @@
+#include "TH2D.h"
+#include "TLorentzVector.h"
+
+#include "Math/LorentzVector.h"
+#include "Math/PtEtaPhiM4D.h"
+#include "Math/Vector4Dfwd.h"
+
+#include "lwtnn/LightweightGraph.hh"
+#include "lwtnn/parse_json.hh"
+
+#include <boost/program_options.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+#include "HiggsAnalysis/friend-tree-producer/interface/Benchmark.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/DenseNetwork.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/WeightMap.h"
+
+namespace po = boost::program_options;
+
+// Runs a kernel on all events and reports the best of several repetitions. The kernel returns a checksum,
+// which is printed such that the computation cannot be optimized away.
+void report(const std::string& kernel, const std::string& variant, unsigned int events, unsigned int repetitions, std::function<double()> run)
+{
+  double best = 0.0;
+  double checksum = 0.0;
+  for(unsigned int r = 0; r < repetitions; r++)
+  {
+    auto start = std::chrono::steady_clock::now();
+    checksum = run();
+    const double seconds = seconds_since(start);
+    if(r == 0 || seconds < best) best = seconds;
+  }
+  std::cout << std::left << std::setw(14) << kernel << std::setw(28) << variant << std::right << std::fixed
+            << std::setprecision(0) << std::setw(14) << events / best << std::setprecision(1) << std::setw(12) << 1e9 * best / events
+            << std::defaultfloat << std::setw(16) << checksum << std::endl;
+}
+
+// Benchmarks of the hot kernels of the producers on random inputs: four-vector building,
+// histogram lookup and neural network inference.
+int main(int argc, char** argv)
+{
+  std::vector<std::string> kernels = {"fourvectors", "histogram", "lwtnn"};
+  unsigned int events = 1000000;
+  unsigned int repetitions = 3;
+  unsigned int block_size = 1000;
+  std::string lwtnn_config = "";
+  std::string output_node = "total_softmax_0";
+
+  po::variables_map vm;
+  po::options_description config("configuration");
+  config.add_options()
+    ("kernels", po::value<std::vector<std::string>>(&kernels)->multitoken())
+    ("events", po::value<unsigned int>(&events)->default_value(events))
+    ("repetitions", po::value<unsigned int>(&repetitions)->default_value(repetitions))
+    ("block_size", po::value<unsigned int>(&block_size)->default_value(block_size), "events per batch of the batched network evaluation")
+    ("lwtnn_config", po::value<std::string>(&lwtnn_config)->default_value(lwtnn_config), "lwtnn graph json of the network benchmark")
+    ("output_node", po::value<std::string>(&output_node)->default_value(output_node));
+  po::store(po::command_line_parser(argc, argv).options(config).run(), vm);
+  po::notify(vm);
+
+  // Random kinematics
+  std::mt19937_64 generator(1);
+  std::uniform_real_distribution<float> eta(-2.5, 2.5), phi(-M_PI, M_PI);
+  std::exponential_distribution<float> pt(1.0 / 40.0);
+  std::vector<float> pts(events), etas(events), phis(events), masses(events, 1.0);
+  for(unsigned int k = 0; k < events; k++)
+  {
+    pts[k] = 20.0 + pt(generator);
+    etas[k] = eta(generator);
+    phis[k] = phi(generator);
+  }
+
+  std::cout << std::left << std::setw(14) << "kernel" << std::setw(28) << "variant" << std::right << std::setw(14) << "events/s"
+            << std::setw(12) << "ns/event" << std::setw(16) << "checksum" << std::endl;
+  for(const auto& kernel : kernels)
+  {
+    if(kernel == "fourvectors")
+    {
+      // Di-object mass of consecutive pairs, as built for every event by SVFit, MELA and NNMass
+      report(kernel, "TLorentzVector", events, repetitions, [&]() {
+        double sum = 0.0;
+        TLorentzVector a, b;
+        for(unsigned int k = 0; k + 1 < events; k++)
+        {
+          a.SetPtEtaPhiM(pts[k], etas[k], phis[k], masses[k]);
+          b.SetPtEtaPhiM(pts[k + 1], etas[k + 1], phis[k + 1], masses[k + 1]);
+          sum += (a + b).M();
+        }
+        return sum;
+      });
+      report(kernel, "ROOT::Math::PtEtaPhiMVector", events, repetitions, [&]() {
+        double sum = 0.0;
+        for(unsigned int k = 0; k + 1 < events; k++)
+        {
+          ROOT::Math::PtEtaPhiMVector a(pts[k], etas[k], phis[k], masses[k]);
+          ROOT::Math::PtEtaPhiMVector b(pts[k + 1], etas[k + 1], phis[k + 1], masses[k + 1]);
+          sum += (a + b).M();
+        }
+        return sum;
+      });
+    }
+    else if(kernel == "histogram")
+    {
+      // Two-dimensional weight lookup as in ZPtMReweighting, with uniform and variable binning
+      std::vector<double> variable_edges = {20.0, 25.0, 30.0, 40.0, 50.0, 70.0, 100.0, 150.0, 200.0, 300.0, 500.0, 1000.0};
+      TH2D uniform_histogram("uniform", "uniform", 50, 20.0, 520.0, 50, 20.0, 520.0);
+      TH2D variable_histogram("variable", "variable", variable_edges.size() - 1, variable_edges.data(), variable_edges.size() - 1, variable_edges.data());
+      uniform_histogram.SetDirectory(0);
+      variable_histogram.SetDirectory(0);
+      for(int bin = 0; bin < uniform_histogram.GetNcells(); bin++) uniform_histogram.SetBinContent(bin, 1.0 + 0.001 * bin);
+      for(int bin = 0; bin < variable_histogram.GetNcells(); bin++) variable_histogram.SetBinContent(bin, 1.0 + 0.001 * bin);
+      std::vector<Float_t> x(pts.begin(), pts.end()), y(pts.rbegin(), pts.rend());
+
+      for(TH2D* histogram : {&uniform_histogram, &variable_histogram})
+      {
+        const std::string binning = histogram == &uniform_histogram ? "uniform" : "variable";
+        report(kernel, "TH2D::FindBin " + binning, events, repetitions, [&]() {
+          double sum = 0.0;
+          for(unsigned int k = 0; k < events; k++) sum += histogram->GetBinContent(histogram->FindBin(x[k], y[k]));
+          return sum;
+        });
+        WeightMap map(*histogram, false);
+        std::vector<Float_t> weights;
+        report(kernel, "WeightMap " + binning, events, repetitions, [&]() {
+          map.evaluate({&x, &y}, weights);
+          double sum = 0.0;
+          for(unsigned int k = 0; k < events; k++) sum += weights[k];
+          return sum;
+        });
+      }
+    }
+    else if(kernel == "lwtnn")
+    {
+      if(lwtnn_config == "")
+      {
+        std::cout << "Skipping lwtnn kernel, since no --lwtnn_config is given" << std::endl;
+        continue;
+      }
+      std::ifstream config_file(lwtnn_config);
+      auto nnconfig = lwt::parse_json_graph(config_file);
+      lwt::LightweightGraph graph(nnconfig, output_node);
+      DenseNetwork network(nnconfig, output_node);
+      const std::vector<std::string>& input_names = network.input_names();
+      const unsigned int n_events = std::min(events, 100000u);
+
+      // Inputs around the offsets of the network, such that the normalized inputs are of order one
+      std::normal_distribution<double> normal(0.0, 1.0);
+      Eigen::MatrixXd inputs(input_names.size(), n_events);
+      for(size_t n = 0; n < input_names.size(); n++)
+      {
+        const lwt::Input& variable = nnconfig.inputs[0].variables[n];
+        for(unsigned int k = 0; k < n_events; k++) inputs(n, k) = -variable.offset + normal(generator) / (variable.scale != 0.0 ? variable.scale : 1.0);
+      }
+
+      report(kernel, "LightweightGraph per event", n_events, repetitions, [&]() {
+        double sum = 0.0;
+        std::map<std::string, std::map<std::string, double>> nodes;
+        for(unsigned int k = 0; k < n_events; k++)
+        {
+          for(size_t n = 0; n < input_names.size(); n++) nodes[nnconfig.inputs[0].name][input_names[n]] = inputs(n, k);
+          for(const auto& output : graph.compute(nodes)) sum += output.second;
+        }
+        return sum;
+      });
+      Eigen::MatrixXd outputs;
+      report(kernel, "DenseNetwork batch " + std::to_string(block_size), n_events, repetitions, [&]() {
+        double sum = 0.0;
+        for(unsigned int first = 0; first < n_events; first += block_size)
+        {
+          const unsigned int size = std::min(block_size, n_events - first);
+          network.compute(inputs.middleCols(first, size), outputs);
+          sum += outputs.sum();
+        }
+        return sum;
+      });
+    }
+    else
+    {
+      std::cout << "Kernel " << kernel << " not available in KernelBenchmark" << std::endl;
+    }
+  }
+
+  std::cout << "Peak RSS: " << peak_rss_kb() / 1024.0 << " MB" << std::endl;
+  return 0;
+}
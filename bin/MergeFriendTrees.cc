@@ -0,0 +1,33 @@
+#include <boost/program_options.hpp>
+
+#include <iostream>
+
+#include "HiggsAnalysis/friend-tree-producer/interface/FriendTreeMerger.h"
+
+namespace po = boost::program_options;
+
+// Merges the friend tree chunks of the jobs into one output file per sample, as configured by the collect command of job_management.py.
+// The chunks are concatenated by copying their compressed baskets, with several output files merged concurrently.
+int main(int argc, char** argv)
+{
+  std::string config_file = "collect.json";
+  unsigned int threads = 4;
+
+  po::variables_map vm;
+  po::options_description config("configuration");
+  config.add_options()
+    ("config", po::value<std::string>(&config_file)->default_value(config_file), "json file with the outputs and their input chunks per folder")
+    ("threads", po::value<unsigned int>(&threads)->default_value(threads), "number of output files merged concurrently");
+  po::store(po::command_line_parser(argc, argv).options(config).run(), vm);
+  po::notify(vm);
+
+  std::vector<MergeTask> tasks = read_merge_tasks(config_file);
+  const size_t failed = merge_friend_trees(tasks, threads);
+  if(failed > 0)
+  {
+    std::cerr << failed << " of " << tasks.size() << " outputs could not be merged" << std::endl;
+    return 1;
+  }
+  std::cout << "Merged " << tasks.size() << " outputs" << std::endl;
+  return 0;
+}
@@ -1,31 +1,17 @@
-#include "lwtnn/LightweightNeuralNetwork.hh"
-#include "lwtnn/LightweightGraph.hh"
-#include "lwtnn/parse_json.hh"
-#include <fstream>
-
-#include "TFile.h"
-#include "TH1F.h"
-#include "TTree.h"
-#include "TLeaf.h"
-#include "TVector2.h"
-#include "Math/LorentzVector.h"
-#include "Math/PtEtaPhiM4D.h"
-#include "Math/PxPyPzM4D.h"
-#include "Math/Vector4Dfwd.h"
-
 #include <boost/algorithm/string.hpp>
 #include <boost/algorithm/string/predicate.hpp>
-#include <boost/algorithm/string/split.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/program_options.hpp>
 #include <boost/regex.hpp>
-#include <boost/property_tree/json_parser.hpp>
-#include <boost/property_tree/ptree.hpp>
 
+#include <chrono>
 #include <iostream>
 
 #include "HiggsAnalysis/friend-tree-producer/interface/HelperFunctions.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/FriendTreeRunner.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/TaskQueue.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/NNScoreProducer.h"
 
 using boost::starts_with;
 namespace po = boost::program_options;
@@ -39,6 +25,12 @@ int main(int argc, char **argv) {
   std::string datasets = std::string(std::getenv("CMSSW_BASE"))+"/src/HiggsAnalysis/friend-tree-producer/data/input_params/datasets.json";
   unsigned int first_entry = 0;
   unsigned int last_entry = 9;
+  unsigned int block_size = 1000;
+  WriterSettings writer_settings;
+  ReaderSettings reader_settings;
+  PipelineSettings pipeline_settings;
+  TaskQueueSettings queue_settings;
+  NetworkSettings network_settings;
   po::variables_map vm;
   po::options_description config("configuration");
   config.add_options()
@@ -49,152 +41,33 @@ int main(int argc, char **argv) {
      ("first_entry",   po::value<unsigned int>(&first_entry)->default_value(first_entry))
      ("last_entry",    po::value<unsigned int>(&last_entry)->default_value(last_entry))
      ("lwtnn_config",  po::value<std::string>(&lwtnn_config)->default_value(lwtnn_config))
-     ("datasets",  po::value<std::string>(&datasets)->default_value(datasets));
+     ("datasets",  po::value<std::string>(&datasets)->default_value(datasets))
+     ("block_size",    po::value<unsigned int>(&block_size)->default_value(block_size));
+  add_writer_options(config, writer_settings);
+  add_reader_options(config, reader_settings);
+  add_pipeline_options(config, pipeline_settings);
+  add_task_queue_options(config, queue_settings);
+  add_network_options(config, network_settings);
   po::store(po::command_line_parser(argc, argv).options(config).run(), vm);
   po::notify(vm);
-  // Add additional info inferred from options above
-  std::vector<std::string> folder_split;
-  boost::split(folder_split, folder, boost::is_any_of("_"));
-  std::string channel = folder_split.at(0);
-  std::vector<std::string> input_split;
-  boost::split(input_split, input, boost::is_any_of("/"));
-  std::string nick = input_split.end()[-2];
-
-  // Load datasets.json to determine year of the sample per nick
-  boost::property_tree::ptree datasets_json;
-  boost::property_tree::json_parser::read_json(datasets,datasets_json);
-  int year = datasets_json.get_child(nick).get<int>("year");
 
-  // Access input file and tree
-  auto in = TFile::Open(input.c_str(), "read");
-  auto dir = (TDirectoryFile *)in->Get(folder.c_str());
-  auto inputtree = (TTree *)dir->Get(tree.c_str());
-  for(std::vector<std::string>::const_iterator s = input_friends.begin(); s != input_friends.end(); ++s)
-  {
-    inputtree->AddFriend((folder+"/"+tree).c_str(), (&(*s))->c_str());
+  // Set up lwtnn & apply the models on the desired events of the input tree
+  auto init_start = std::chrono::steady_clock::now();
+  NNScoreProducer producer(lwtnn_config, datasets, network_settings);
+  init_times()[producer.name()] = seconds_since(init_start);
+  if (queue_settings.enabled()) {
+    // Process all tasks of the task file or spool directory with the same producer
+    auto outputnames = [](const ProducerTask &task) {
+      return std::vector<std::string>{outputname_from_settings(
+          task.input, task.folder, task.first_entry, task.last_entry)};
+    };
+    return run_task_queue({&producer}, outputnames, queue_settings, tree,
+                          block_size, writer_settings, reader_settings, pipeline_settings) > 0;
   }
-
-  // Set up lwtnn
-  if (!boost::filesystem::exists(lwtnn_config)) {
-      throw std::runtime_error("LWTNN config file does not exist.");
-  }
-  //std::map<int,lwt::LightweightNeuralNetwork*> models;
-  std::map<int,lwt::LightweightGraph*> models;
-
-//  std::ifstream config_file0(lwtnn_config+"/"+std::to_string(year)+"/"+channel+"/fold0_lwtnn.json");
-//  auto nnconfig0 = lwt::parse_json(config_file0);
-//  models[1] = new lwt::LightweightNeuralNetwork(nnconfig0.inputs, nnconfig0.layers, nnconfig0.outputs);
-//  std::cout << "Loading fold0 model for application on ODD events (event % 2 == 1)" << std::endl;
-//
-//  std::ifstream config_file1(lwtnn_config+"/"+std::to_string(year)+"/"+channel+"/fold1_lwtnn.json");
-//  auto nnconfig1 = lwt::parse_json(config_file1);
-//  models[0] = new lwt::LightweightNeuralNetwork(nnconfig1.inputs, nnconfig1.layers, nnconfig1.outputs);
-//  std::cout << "Loading fold1 model for application on EVEN events (event % 2 == 0)" << std::endl;
-
-  std::ifstream config_file0(lwtnn_config+"/"+std::to_string(year)+"/"+channel+"/fold0_lwtnn.json");
-  auto nnconfig0 = lwt::parse_json_graph(config_file0);
-  models[1] = new lwt::LightweightGraph(nnconfig0, "total_softmax_0");
-  std::cout << "Loading fold0 model for application on ODD events (event % 2 == 1)" << std::endl;
-
-  std::ifstream config_file1(lwtnn_config+"/"+std::to_string(year)+"/"+channel+"/fold1_lwtnn.json");
-  auto nnconfig1 = lwt::parse_json_graph(config_file1);
-  models[0] = new lwt::LightweightGraph(nnconfig1, "total_softmax_0");
-  std::cout << "Loading fold1 model for application on EVEN events (event % 2 == 0)" << std::endl;
-
-  // Initialize inputs
-  std::map<std::string, Float_t> float_inputs;
-  std::map<std::string, Int_t> int_inputs;
-  for(size_t n=0; n < nnconfig0.inputs[0].variables.size(); n++)
-  {
-    std::string input_type = inputtree->GetLeaf((nnconfig0.inputs[0].variables.at(n).name).c_str())->GetTypeName();
-    if(input_type == "Float_t")
-    {
-        float_inputs[nnconfig0.inputs[0].variables.at(n).name] = 0.0;
-        inputtree->SetBranchAddress((nnconfig0.inputs[0].variables.at(n).name).c_str(), &(float_inputs.find(nnconfig0.inputs[0].variables.at(n).name)->second));
-    }
-    else if(input_type == "Int_t")
-    {
-        int_inputs[nnconfig0.inputs[0].variables.at(n).name] = 0;
-        inputtree->SetBranchAddress((nnconfig0.inputs[0].variables.at(n).name).c_str(), &(int_inputs.find(nnconfig0.inputs[0].variables.at(n).name)->second));
-    }
-    else
-    {
-        std::cout << "Type " << input_type << " not implemented! Exiting with error code '1'" << std::endl;
-        return 1;
-    }
-  }
-  ULong64_t event;
-  inputtree->SetBranchAddress("event", &event);
-
-  // Initialize output file
+  ProducerTask task = {input, input_friends, folder, tree, first_entry, last_entry};
   auto outputname =
       outputname_from_settings(input, folder, first_entry, last_entry);
-  boost::filesystem::create_directories(filename_from_inputpath(input));
-  auto out = TFile::Open(outputname.c_str(), "recreate");
-  out->mkdir(folder.c_str());
-  out->cd(folder.c_str());
-
-  // Create output tree
-  auto nnfriend = new TTree("ntuple", "NN score friend tree");
-
-  // Initialize outputs for the tree
-  std::map<std::string, Float_t> outputs;
-  for(size_t n=0; n < nnconfig0.outputs["total_softmax_0"].labels.size(); n++)
-  {
-    outputs[nnconfig0.outputs["total_softmax_0"].labels.at(n)] = 0.0;
-    nnfriend->Branch((channel+"_"+nnconfig0.outputs["total_softmax_0"].labels.at(n)).c_str(), &(outputs.find(nnconfig0.outputs["total_softmax_0"].labels.at(n))->second), (channel+"_"+nnconfig0.outputs["total_softmax_0"].labels.at(n)+"/F").c_str());
-  }
-  Float_t max_score = default_float;
-  Float_t max_index = 0.0;
-  std::string max_score_name = channel+"_max_score";
-  std::string max_index_name = channel+"_max_index";
-  nnfriend->Branch(max_score_name.c_str(), &max_score, (max_score_name+"/F").c_str());
-  nnfriend->Branch(max_index_name.c_str(), &max_index, (max_index_name+"/F").c_str());
-
-  // Loop over desired events of the input tree & compute outputs
-  for (unsigned int i = first_entry; i <= last_entry; i++) {
-    // Get entry
-    inputtree->GetEntry(i);
-
-    // Convert the inputs from Float_t to double
-    std::map<std::string, std::map<std::string, double>> model_inputs;
-    for(auto &in : float_inputs)
-    {
-      model_inputs["node_0"][in.first] = in.second;
-    }
-    for(auto &in : int_inputs)
-    {
-      model_inputs["node_0"][in.first] = in.second;
-    }
-   
-    // Apply model on inputs
-    auto model_outputs = models[event % 2]->compute(model_inputs);
-
-    // Fill output map
-    for(size_t index=0; index < nnconfig0.outputs["total_softmax_0"].labels.size(); index++)
-    {
-      auto output_value = model_outputs[nnconfig0.outputs["total_softmax_0"].labels.at(index)];
-      outputs[nnconfig0.outputs["total_softmax_0"].labels.at(index)] = output_value;
-      if (output_value > max_score)
-      {
-        max_score = output_value;
-        max_index = index;
-      }
-    }
-
-    // Fill output tree
-    nnfriend->Fill();
-
-    // Reset max quantities
-    max_score = default_float;
-    max_index = 0.0;
-  }
-
-  // Fill output file
-  out->cd(folder.c_str());
-  nnfriend->Write("", TObject::kOverwrite);
-  out->Close();
-  in->Close();
+  run_producers({&producer}, {outputname}, task, block_size, writer_settings, reader_settings, pipeline_settings);
 
   return 0;
 }
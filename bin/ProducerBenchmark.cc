@@ -0,0 +1,176 @@
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <utility>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "HiggsAnalysis/friend-tree-producer/interface/Benchmark.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/CorrectionWeightsProducer.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/FriendTreeRunner.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/HelperFunctions.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/MELAProducer.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/NNMassProducer.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/NNScoreProducer.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/NNrecoilProducer.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/SVFitProducer.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/SyntheticNtuple.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/ZPtMReweightingProducer.h"
+
+namespace po = boost::program_options;
+
+// Measurements of a single producer, handed from the benchmark process to the main process
+struct BenchmarkResult
+{
+  double init_seconds;
+  double total_seconds;
+  double compute_seconds;
+  unsigned long events;
+  double latency_mean;
+  double latency_median;
+  double latency_p99;
+  long peak_rss_kb;
+};
+
+// Runs each producer separately on the same input and reports its throughput, per-event latency and peak memory.
+// Without --input, a synthetic ntuple is generated first. Each producer is run in its own process,
+// such that its initialization and peak memory are measured independently of the other producers.
+int main(int argc, char** argv)
+{
+  std::string input = "";
+  std::string work_dir = "benchmark";
+  std::string folder = "mt_nominal";
+  std::string tree = "ntuple";
+  std::vector<std::string> producer_names = {"SVFit", "MELA", "NNrecoil", "ZPtMReweighting"};
+  unsigned int events = 10000;
+  unsigned int block_size = 1000;
+
+  unsigned int threads = 1;
+  unsigned int mela_workers = 0;
+  std::string lwtnn_config = "model.json";
+  std::string nn_lwtnn_config = std::string(std::getenv("CMSSW_BASE"))+"/src/HiggsAnalysis/friend-tree-producer/data/inputs_lwtnn/";
+  std::string datasets = "";
+  std::string weight_directory = std::string(std::getenv("CMSSW_BASE"))+"/src/HiggsAnalysis/friend-tree-producer/data/zptm_reweighting/";
+  std::string weights_config = std::string(std::getenv("CMSSW_BASE"))+"/src/HiggsAnalysis/friend-tree-producer/data/correction_weights.json";
+  std::string data_directory = std::string(std::getenv("CMSSW_BASE"))+"/src/HiggsAnalysis/friend-tree-producer/data/";
+
+  WriterSettings writer_settings;
+  ReaderSettings reader_settings;
+  PipelineSettings pipeline_settings;
+  NetworkSettings network_settings;
+  po::variables_map vm;
+  po::options_description config("configuration");
+  config.add_options()
+    ("input", po::value<std::string>(&input)->default_value(input), "input ntuple; a synthetic ntuple is generated if empty")
+    ("work_dir", po::value<std::string>(&work_dir)->default_value(work_dir))
+    ("folder", po::value<std::string>(&folder)->default_value(folder))
+    ("tree", po::value<std::string>(&tree)->default_value(tree))
+    ("events", po::value<unsigned int>(&events)->default_value(events))
+    ("block_size", po::value<unsigned int>(&block_size)->default_value(block_size))
+    ("producers", po::value<std::vector<std::string>>(&producer_names)->multitoken())
+    ("threads", po::value<unsigned int>(&threads)->default_value(threads))
+    ("mela_workers", po::value<unsigned int>(&mela_workers)->default_value(mela_workers))
+    ("lwtnn_config", po::value<std::string>(&lwtnn_config)->default_value(lwtnn_config))
+    ("nn_lwtnn_config", po::value<std::string>(&nn_lwtnn_config)->default_value(nn_lwtnn_config))
+    ("datasets", po::value<std::string>(&datasets)->default_value(datasets), "datasets.json; the one of the synthetic ntuple is used if empty")
+    ("weights_config", po::value<std::string>(&weights_config)->default_value(weights_config));
+  add_writer_options(config, writer_settings);
+  add_reader_options(config, reader_settings);
+  add_pipeline_options(config, pipeline_settings);
+  add_network_options(config, network_settings);
+  po::store(po::command_line_parser(argc, argv).options(config).run(), vm);
+  po::notify(vm);
+
+  // Generate the input, if not given
+  if(input == "")
+  {
+    SyntheticNtuple ntuple(1);
+    input = ntuple.write((fs::path(work_dir) / "synthetic").string(), "SyntheticDYJetsToLL", {folder_to_channel(folder)}, events);
+    if(datasets == "") datasets = SyntheticNtuple::write_datasets((fs::path(work_dir) / "synthetic").string(), "SyntheticDYJetsToLL", 2017);
+  }
+  Long64_t entries = std::min(tree_entries(input, folder, tree), Long64_t(events));
+  ProducerTask task = {input, {}, folder, tree, 0, entries - 1};
+
+  std::vector<std::pair<std::string, BenchmarkResult>> results;
+  for(const auto& producer_name : producer_names)
+  {
+    int result_pipe[2];
+    if(pipe(result_pipe) != 0) throw std::runtime_error("Could not create pipe.");
+    std::cout.flush();
+    pid_t pid = fork();
+    if(pid == 0)
+    {
+      // Benchmark process of a single producer
+      close(result_pipe[0]);
+      BenchmarkResult result;
+      int status = 0;
+      try
+      {
+        auto start = std::chrono::steady_clock::now();
+        std::unique_ptr<FriendProducer> producer;
+        if(producer_name == "SVFit") producer.reset(new SVFitProducer(threads));
+        else if(producer_name == "MELA") producer.reset(new MELAProducer("", mela_workers));
+        else if(producer_name == "NNMass") producer.reset(new NNMassProducer(lwtnn_config, network_settings));
+        else if(producer_name == "NNScore") producer.reset(new NNScoreProducer(nn_lwtnn_config, datasets, network_settings));
+        else if(producer_name == "NNrecoil") producer.reset(new NNrecoilProducer(nn_lwtnn_config, network_settings));
+        else if(producer_name == "ZPtMReweighting") producer.reset(new ZPtMReweightingProducer(datasets, weight_directory));
+        else if(producer_name == "CorrectionWeights") producer.reset(new CorrectionWeightsProducer(read_correction_weights(weights_config), datasets, data_directory));
+        else throw std::runtime_error("Producer " + producer_name + " not available in ProducerBenchmark.");
+        result.init_seconds = seconds_since(start);
+
+        TimedProducer timed_producer(*producer);
+        auto outputname = outputname_from_settings(input, folder, task.first_entry, task.last_entry, fs::path(work_dir) / producer_name);
+        start = std::chrono::steady_clock::now();
+        run_producers({&timed_producer}, {outputname}, task, block_size, writer_settings, reader_settings, pipeline_settings);
+        result.total_seconds = seconds_since(start);
+        result.compute_seconds = timed_producer.compute_seconds();
+        result.events = timed_producer.events();
+        result.latency_mean = result.compute_seconds / std::max(result.events, 1ul);
+        result.latency_median = quantile(timed_producer.latencies(), 0.5);
+        result.latency_p99 = quantile(timed_producer.latencies(), 0.99);
+        result.peak_rss_kb = peak_rss_kb();
+        if(write(result_pipe[1], &result, sizeof(result)) != sizeof(result)) status = 1;
+      }
+      catch(const std::exception& e)
+      {
+        std::cerr << producer_name << ": " << e.what() << std::endl;
+        status = 1;
+      }
+      std::cout.flush();
+      _exit(status);
+    }
+    close(result_pipe[1]);
+    BenchmarkResult result;
+    const bool received = read(result_pipe[0], &result, sizeof(result)) == sizeof(result);
+    close(result_pipe[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if(!received)
+    {
+      std::cout << producer_name << " failed" << std::endl;
+      continue;
+    }
+    results.emplace_back(producer_name, result);
+  }
+
+  // Summary of all producers
+  std::cout << std::left << std::setw(20) << "producer" << std::right << std::setw(10) << "events" << std::setw(10) << "init [s]"
+            << std::setw(10) << "total [s]" << std::setw(12) << "events/s" << std::setw(14) << "compute/s" << std::setw(14) << "mean [us]"
+            << std::setw(14) << "median [us]" << std::setw(14) << "p99 [us]" << std::setw(14) << "peak RSS [MB]" << std::endl;
+  for(const auto& producer_result : results)
+  {
+    const BenchmarkResult& result = producer_result.second;
+    std::cout << std::left << std::setw(20) << producer_result.first << std::right << std::setw(10) << result.events << std::fixed << std::setprecision(2)
+              << std::setw(10) << result.init_seconds << std::setw(10) << result.total_seconds
+              << std::setprecision(0) << std::setw(12) << result.events / result.total_seconds << std::setw(14) << result.events / result.compute_seconds
+              << std::setprecision(2) << std::setw(14) << 1e6 * result.latency_mean << std::setw(14) << 1e6 * result.latency_median
+              << std::setw(14) << 1e6 * result.latency_p99 << std::setprecision(1) << std::setw(14) << result.peak_rss_kb / 1024.0 << std::endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,42 @@
+#include <boost/program_options.hpp>
+
+#include <iostream>
+
+#include "HiggsAnalysis/friend-tree-producer/interface/SyntheticNtuple.h"
+
+namespace po = boost::program_options;
+
+// Writes a synthetic ntuple <output_dir>/<nick>/<nick>.root with random events for the given channels,
+// together with a datasets.json assigning the year to the nick, as input for benchmarks of the producers.
+int main(int argc, char** argv)
+{
+  std::string output_dir = "synthetic";
+  std::string nick = "SyntheticDYJetsToLL";
+  std::vector<std::string> channels = {"et", "mt", "tt", "em"};
+  std::vector<std::string> extra_branches = {};
+  unsigned int events = 10000;
+  unsigned int seed = 1;
+  int year = 2017;
+
+  po::variables_map vm;
+  po::options_description config("configuration");
+  config.add_options()
+    ("output_dir", po::value<std::string>(&output_dir)->default_value(output_dir))
+    ("nick", po::value<std::string>(&nick)->default_value(nick))
+    ("channels", po::value<std::vector<std::string>>(&channels)->multitoken())
+    ("extra_branches", po::value<std::vector<std::string>>(&extra_branches)->multitoken(), "additional float branches, e.g. inputs of NNScore models")
+    ("events", po::value<unsigned int>(&events)->default_value(events), "events per channel")
+    ("seed", po::value<unsigned int>(&seed)->default_value(seed))
+    ("year", po::value<int>(&year)->default_value(year));
+  po::store(po::command_line_parser(argc, argv).options(config).run(), vm);
+  po::notify(vm);
+
+  SyntheticNtuple ntuple(seed, extra_branches);
+  std::string outputname = ntuple.write(output_dir, nick, channels, events);
+  std::cout << "Written " << events << " events per channel to " << outputname << std::endl;
+
+  std::string datasets = SyntheticNtuple::write_datasets(output_dir, nick, year);
+  std::cout << "Written " << datasets << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,134 @@
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+
+#include "HiggsAnalysis/friend-tree-producer/interface/Benchmark.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/FriendTreeRunner.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/HelperFunctions.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/NNMassProducer.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/NNScoreProducer.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/NNrecoilProducer.h"
+
+namespace fs = boost::filesystem;
+namespace po = boost::program_options;
+
+// Kolmogorov-Smirnov distance between the distributions of two sets of values
+double ks_distance(std::vector<double> a, std::vector<double> b)
+{
+  if(a.size() == 0 || b.size() == 0) return 0.0;
+  std::sort(a.begin(), a.end());
+  std::sort(b.begin(), b.end());
+  double distance = 0.0;
+  size_t i = 0, j = 0;
+  while(i < a.size() && j < b.size())
+  {
+    const double value = std::min(a[i], b[j]);
+    while(i < a.size() && a[i] <= value) i++;
+    while(j < b.size() && b[j] <= value) j++;
+    distance = std::max(distance, std::fabs(double(i) / a.size() - double(j) / b.size()));
+  }
+  return distance;
+}
+
+// Runs an NN producer with its networks evaluated in each precision on a single read of a reference ntuple,
+// and compares every output branch of the reduced precisions with the double precision outputs:
+// maximal, mean and quantiles of the absolute deviation per event, and the Kolmogorov-Smirnov distance of the distributions.
+int main(int argc, char** argv)
+{
+  std::string producer_name = "NNScore";
+  std::string input = "output.root";
+  std::vector<std::string> input_friends = {};
+  std::string folder = "mt_nominal";
+  std::string tree = "ntuple";
+  unsigned int first_entry = 0;
+  unsigned int last_entry = 99999;
+  unsigned int block_size = 1000;
+  std::string work_dir = "precision_validation";
+  std::vector<std::string> precisions = {"float", "int8"};
+  std::string lwtnn_config = "model.json";
+  std::string nn_lwtnn_config = std::string(std::getenv("CMSSW_BASE"))+"/src/HiggsAnalysis/friend-tree-producer/data/inputs_lwtnn/";
+  std::string datasets = std::string(std::getenv("CMSSW_BASE"))+"/src/HiggsAnalysis/friend-tree-producer/data/input_params/datasets.json";
+
+  po::variables_map vm;
+  po::options_description config("configuration");
+  config.add_options()
+    ("producer", po::value<std::string>(&producer_name)->default_value(producer_name), "NNScore, NNMass or NNrecoil")
+    ("input", po::value<std::string>(&input)->default_value(input), "reference ntuple")
+    ("input_friends", po::value<std::vector<std::string>>(&input_friends)->multitoken())
+    ("folder", po::value<std::string>(&folder)->default_value(folder))
+    ("tree", po::value<std::string>(&tree)->default_value(tree))
+    ("first_entry", po::value<unsigned int>(&first_entry)->default_value(first_entry))
+    ("last_entry", po::value<unsigned int>(&last_entry)->default_value(last_entry))
+    ("block_size", po::value<unsigned int>(&block_size)->default_value(block_size))
+    ("work_dir", po::value<std::string>(&work_dir)->default_value(work_dir))
+    ("precisions", po::value<std::vector<std::string>>(&precisions)->multitoken(), "reduced precisions to compare with double precision")
+    ("lwtnn_config", po::value<std::string>(&lwtnn_config)->default_value(lwtnn_config), "model of NNMass")
+    ("nn_lwtnn_config", po::value<std::string>(&nn_lwtnn_config)->default_value(nn_lwtnn_config), "directory of the NNScore and NNrecoil models")
+    ("datasets", po::value<std::string>(&datasets)->default_value(datasets));
+  po::store(po::command_line_parser(argc, argv).options(config).run(), vm);
+  po::notify(vm);
+
+  // One producer per precision, run on the same read of the input
+  std::vector<std::string> all_precisions = {"double"};
+  all_precisions.insert(all_precisions.end(), precisions.begin(), precisions.end());
+  std::vector<std::unique_ptr<FriendProducer>> producers;
+  std::vector<std::unique_ptr<TimedProducer>> timed_producers;
+  std::vector<FriendProducer*> producer_pointers;
+  std::vector<std::string> outputnames;
+  for(const auto& precision : all_precisions)
+  {
+    NetworkSettings network_settings;
+    network_settings.precision = precision;
+    if(producer_name == "NNScore") producers.emplace_back(new NNScoreProducer(nn_lwtnn_config, datasets, network_settings));
+    else if(producer_name == "NNMass") producers.emplace_back(new NNMassProducer(lwtnn_config, network_settings));
+    else if(producer_name == "NNrecoil") producers.emplace_back(new NNrecoilProducer(nn_lwtnn_config, network_settings));
+    else throw std::runtime_error("Producer " + producer_name + " not available in ValidateNetworkPrecision.");
+    timed_producers.emplace_back(new TimedProducer(*producers.back()));
+    producer_pointers.push_back(timed_producers.back().get());
+    outputnames.push_back(outputname_from_settings(input, folder, first_entry, last_entry, fs::path(work_dir) / precision));
+  }
+  ProducerTask task = {input, input_friends, folder, tree, first_entry, last_entry};
+  run_producers(producer_pointers, outputnames, task, block_size);
+
+  // Compare the outputs of each reduced precision with double precision
+  std::cout << "Kernels of this CPU: " << simd_instruction_set() << std::endl;
+  const auto reference = read_branches(outputnames[0], folder);
+  std::cout << std::left << std::setw(40) << "branch" << std::setw(10) << "precision" << std::right << std::setw(14) << "max |diff|" << std::setw(14) << "mean |diff|"
+            << std::setw(14) << "median" << std::setw(14) << "p99" << std::setw(14) << "p99.9" << std::setw(14) << "KS distance" << std::endl;
+  for(size_t p = 1; p < all_precisions.size(); p++)
+  {
+    const auto branches = read_branches(outputnames[p], folder);
+    for(const auto& branch : reference)
+    {
+      const std::vector<double>& values = branches.at(branch.first);
+      std::vector<double> deviations(values.size());
+      double mean = 0.0;
+      for(size_t k = 0; k < values.size(); k++)
+      {
+        deviations[k] = std::fabs(values[k] - branch.second[k]);
+        mean += deviations[k] / values.size();
+      }
+      const double max = deviations.size() > 0 ? *std::max_element(deviations.begin(), deviations.end()) : 0.0;
+      std::cout << std::left << std::setw(40) << branch.first << std::setw(10) << all_precisions[p] << std::right << std::scientific << std::setprecision(3)
+                << std::setw(14) << max << std::setw(14) << mean << std::setw(14) << quantile(deviations, 0.5) << std::setw(14) << quantile(deviations, 0.99)
+                << std::setw(14) << quantile(deviations, 0.999) << std::setw(14) << ks_distance(values, branch.second) << std::endl;
+    }
+  }
+
+  // Compute time of each precision
+  std::cout << std::endl << std::left << std::setw(10) << "precision" << std::right << std::setw(14) << "compute [s]" << std::setw(14) << "events/s" << std::setw(10) << "speedup" << std::endl;
+  for(size_t p = 0; p < all_precisions.size(); p++)
+  {
+    const double seconds = timed_producers[p]->compute_seconds();
+    std::cout << std::left << std::setw(10) << all_precisions[p] << std::right << std::fixed << std::setprecision(3) << std::setw(14) << seconds << std::setprecision(0)
+              << std::setw(14) << timed_producers[p]->events() / std::max(seconds, 1e-9) << std::setprecision(2) << std::setw(10)
+              << timed_producers[0]->compute_seconds() / std::max(seconds, 1e-9) << std::endl;
+  }
+  return 0;
+}
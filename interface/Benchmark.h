@@ -0,0 +1,90 @@
+#ifndef FRIEND_TREE_PRODUCER_BENCHMARK_H
+#define FRIEND_TREE_PRODUCER_BENCHMARK_H
+
+#include "TFile.h"
+#include "TLeaf.h"
+#include "TObjArray.h"
+#include "TTree.h"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "HiggsAnalysis/friend-tree-producer/interface/FriendProducer.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/JobMetrics.h"
+
+// Quantile of a list of values, e.g. 0.5 for the median
+inline double quantile(std::vector<double> values, double q)
+{
+    if(values.size() == 0) return 0.0;
+    const size_t position = std::min(values.size() - 1, size_t(q * values.size()));
+    std::nth_element(values.begin(), values.begin() + position, values.end());
+    return values[position];
+}
+
+// Values of all branches of the friend tree in a producer output
+inline std::map<std::string, std::vector<double>> read_branches(const std::string& outputname, const std::string& folder)
+{
+    std::map<std::string, std::vector<double>> branches;
+    TFile* file = TFile::Open(outputname.c_str(), "read");
+    if(!file || file->IsZombie()) throw std::runtime_error("Could not open " + outputname + ".");
+    TTree* tree = (TTree*) file->Get((folder + "/ntuple").c_str());
+    TObjArray* branch_list = tree->GetListOfBranches();
+    std::vector<std::pair<std::string, TLeaf*>> leaves;
+    for(int b = 0; b < branch_list->GetEntries(); b++)
+    {
+        const std::string name = branch_list->At(b)->GetName();
+        leaves.emplace_back(name, tree->GetLeaf(name.c_str()));
+    }
+    for(Long64_t entry = 0; entry < tree->GetEntries(); entry++)
+    {
+        tree->GetEntry(entry);
+        for(const auto& leaf : leaves) branches[leaf.first].push_back(leaf.second->GetValue());
+    }
+    file->Close();
+    return branches;
+}
+
+// Wrapper around a producer, which measures the time spent in compute() for each block.
+// The per-event latency of a block is its compute time divided by its size, such that the
+// latency of single events is measured with a block size of 1.
+class TimedProducer : public FriendProducer
+{
+  public:
+    explicit TimedProducer(FriendProducer& producer) : producer_(producer), compute_seconds_(0.0), events_(0) {}
+
+    std::string name() const override { return producer_.name(); }
+    std::string title() const override { return producer_.title(); }
+    std::map<std::string, std::string> metadata() const override { return producer_.metadata(); }
+
+    void declare(const ProducerTask& task, InputSchema& inputs, OutputSchema& outputs) override { producer_.declare(task, inputs, outputs); }
+    void select(const InputBlock& inputs, std::vector<bool>& selected) const override { producer_.select(inputs, selected); }
+
+    void compute(const InputBlock& inputs, const std::vector<bool>& selected, OutputBlock& outputs) override
+    {
+        const auto start = std::chrono::steady_clock::now();
+        producer_.compute(inputs, selected, outputs);
+        const double seconds = seconds_since(start);
+        compute_seconds_ += seconds;
+        events_ += inputs.size();
+        if(inputs.size() > 0) latencies_.push_back(seconds / inputs.size());
+    }
+
+    void finish() override { producer_.finish(); }
+
+    double compute_seconds() const { return compute_seconds_; }
+    size_t events() const { return events_; }
+    // Per-event latencies of all blocks in seconds
+    const std::vector<double>& latencies() const { return latencies_; }
+
+  private:
+    FriendProducer& producer_;
+    double compute_seconds_;
+    size_t events_;
+    std::vector<double> latencies_;
+};
+
+#endif
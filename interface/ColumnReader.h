@@ -0,0 +1,240 @@
+#ifndef FRIEND_TREE_PRODUCER_COLUMNREADER_H
+#define FRIEND_TREE_PRODUCER_COLUMNREADER_H
+
+#include "TBranch.h"
+#include "TEnv.h"
+#include "TFile.h"
+#include "TTree.h"
+
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "HiggsAnalysis/friend-tree-producer/interface/FriendProducer.h"
+
+// Read settings shared by all friend tree executables
+struct ReaderSettings
+{
+    // Size of the TTreeCache of the input tree and of each friend tree in bytes, 0 to disable the caches
+    Long64_t cache_size = 30000000;
+    // Prefetch the baskets of the next cache fill on a separate thread while the current one is processed
+    bool async_prefetch = false;
+};
+
+inline void add_reader_options(boost::program_options::options_description& config, ReaderSettings& settings)
+{
+    namespace po = boost::program_options;
+    config.add_options()
+        ("cache_size", po::value<Long64_t>(&settings.cache_size)->default_value(settings.cache_size), "TTreeCache size in bytes for the input tree and each friend tree, 0 to disable")
+        ("async_prefetch", po::bool_switch(&settings.async_prefetch), "prefetch the input baskets asynchronously");
+}
+
+// Reads the declared input branches of an input tree and its friends column by column into InputBlocks.
+//
+// All other branches are disabled, such that their baskets are never decompressed. Each declared branch
+// is read separately for all entries of a block into a contiguous array, so the baskets of one branch
+// are processed in sequence instead of switching between all branches for every entry.
+// Friend trees have to be aligned with the input tree by entry number.
+//
+// With configure_cache(), the input tree and each friend tree get a TTreeCache restricted to their declared branches
+// and the entry range of the task, such that the baskets are fetched in a few large reads instead of one read per basket.
+//
+// A block is read in two phases: read() reads the branches needed for all entries, read_selected()
+// the branches declared with InputSchema::add_selected() for the entries selected by their producers.
+class ColumnReader
+{
+  public:
+    ColumnReader(TTree* tree, const InputSchema& schema) : tree_(tree), schema_(schema), cached_(false), n_selected_(0), n_skipped_(0)
+    {
+        tree_->SetBranchStatus("*", 0);
+        bind<Float_t>();
+        bind<Double_t>();
+        bind<Int_t>();
+        bind<UInt_t>();
+        bind<ULong64_t>();
+
+        // Read counters of the files of all trees, to report the reads of this task only
+        for(const auto& tree_branches : tree_branches_)
+        {
+            TFile* file = tree_branches.first->GetCurrentFile();
+            if(file && files_.find(file) == files_.end()) files_[file] = std::make_pair(file->GetReadCalls(), file->GetBytesRead());
+        }
+    }
+
+    // Sets up the TTreeCache of the input tree and each friend tree with their declared branches, for the entries from first_entry to last_entry
+    void configure_cache(const ReaderSettings& settings, Long64_t first_entry, Long64_t last_entry)
+    {
+        if(settings.cache_size <= 0) return;
+        // The prefetching is set up by the TTreeCache on creation
+        if(settings.async_prefetch) gEnv->SetValue("TFile.AsyncPrefetching", 1);
+        for(const auto& tree_branches : tree_branches_)
+        {
+            TTree* tree = tree_branches.first;
+            tree->SetCacheSize(settings.cache_size);
+            for(const auto& branch : tree_branches.second) tree->AddBranchToCache(branch.c_str(), false);
+            tree->StopCacheLearningPhase();
+            tree->SetCacheEntryRange(first_entry, last_entry + 1);
+        }
+        cached_ = true;
+    }
+
+    // Read calls and bytes read from the files of the input tree and its friends since the reader was created
+    Long64_t read_calls() const
+    {
+        Long64_t calls = 0;
+        for(const auto& file : files_) calls += file.first->GetReadCalls() - file.second.first;
+        return calls;
+    }
+
+    Long64_t bytes_read() const
+    {
+        Long64_t bytes = 0;
+        for(const auto& file : files_) bytes += file.first->GetBytesRead() - file.second.second;
+        return bytes;
+    }
+
+    void read(Long64_t first_entry, size_t size, InputBlock& block)
+    {
+        block.reset(first_entry, size);
+        read_entries(block, nullptr);
+    }
+
+    // Reads the remaining branches, given the selected entries of the block for each producer
+    void read_selected(InputBlock& block, const std::vector<std::vector<bool>>& selections) { read_entries(block, &selections); }
+
+    std::string summary() const
+    {
+        return "read " + std::to_string(n_selected_) + " values of selected branches, skipped " + std::to_string(n_skipped_) + " values of unselected entries, "
+               + std::to_string(read_calls()) + " read calls with " + std::to_string(bytes_read()) + " bytes from " + std::to_string(files_.size()) + " files";
+    }
+
+  private:
+    template <typename T>
+    struct BranchPointers
+    {
+        std::vector<TBranch*> branches;
+    };
+    template <typename T>
+    using ValueList = std::vector<T>;
+
+    template <typename T>
+    void bind()
+    {
+        const std::vector<std::string>& names = schema_.branches<T>();
+        std::vector<TBranch*>& branches = std::get<BranchPointers<T>>(branches_).branches;
+        std::vector<T>& values = std::get<ValueList<T>>(values_);
+        values.resize(names.size());
+        for(size_t index = 0; index < names.size(); index++)
+        {
+            tree_->SetBranchStatus(names[index].c_str(), 1);
+            TBranch* branch = tree_->GetBranch(names[index].c_str());
+            if(!branch) throw std::runtime_error("Branch " + names[index] + " not found in input tree.");
+            if(branch->GetTree() != tree_ && branch->GetTree()->GetTreeIndex())
+            {
+                throw std::runtime_error("Branch " + names[index] + " belongs to an indexed friend tree, which is not supported by ColumnReader.");
+            }
+            branch->SetAddress(&values[index]);
+            branches.push_back(branch);
+            tree_branches_[branch->GetTree()].push_back(branch->GetName());
+        }
+    }
+
+    // First entry after the cluster of the given entry in the input tree and all friend trees
+    Long64_t cluster_end(Long64_t entry, Long64_t last) const
+    {
+        Long64_t end = last;
+        for(const auto& tree_branches : tree_branches_)
+        {
+            TTree::TClusterIterator cluster = tree_branches.first->GetClusterIterator(entry);
+            cluster.Next();
+            const Long64_t next = cluster.GetNextEntry();
+            if(next > entry) end = std::min(end, next);
+        }
+        return end;
+    }
+
+    // With TTreeCaches, the block is read in segments within one cluster of all trees. TBranch::GetEntry does not move the read entry
+    // of the trees, from which their TTreeCaches determine the cluster to fill, so it is set with LoadTree() at the start of each segment.
+    // Friend trees with other cluster boundaries give shorter segments, but each cluster of each tree is still fetched once.
+    void read_entries(InputBlock& block, const std::vector<std::vector<bool>>* selections)
+    {
+        const Long64_t first_entry = block.first_entry();
+        const Long64_t last_entry = first_entry + block.size();
+        for(Long64_t begin = first_entry; begin < last_entry;)
+        {
+            const Long64_t end = cached_ ? cluster_end(begin, last_entry) : last_entry;
+            if(cached_ && tree_->LoadTree(begin) < 0) throw std::runtime_error("Could not load entry " + std::to_string(begin) + " of the input tree.");
+            read_columns<Float_t>(block, selections, begin - first_entry, end - first_entry);
+            read_columns<Double_t>(block, selections, begin - first_entry, end - first_entry);
+            read_columns<Int_t>(block, selections, begin - first_entry, end - first_entry);
+            read_columns<UInt_t>(block, selections, begin - first_entry, end - first_entry);
+            read_columns<ULong64_t>(block, selections, begin - first_entry, end - first_entry);
+            begin = end;
+        }
+    }
+
+    // Reads the entries from begin to end of the block, counted from its first entry
+    template <typename T>
+    void read_columns(InputBlock& block, const std::vector<std::vector<bool>>* selections, size_t begin, size_t end)
+    {
+        const std::vector<TBranch*>& branches = std::get<BranchPointers<T>>(branches_).branches;
+        const std::vector<T>& values = std::get<ValueList<T>>(values_);
+        ColumnList<T>& columns = block.columns<T>();
+        columns.resize(branches.size());
+        std::vector<bool> selected;
+        for(size_t index = 0; index < branches.size(); index++)
+        {
+            // The first phase reads the branches needed for all entries, the second phase all other branches
+            if(schema_.all_entries<T>(index) == (selections != nullptr)) continue;
+            selected.assign(block.size(), selections == nullptr);
+            if(selections)
+            {
+                for(auto producer : schema_.selecting_producers<T>(index))
+                {
+                    for(size_t k = begin; k < end; k++) selected[k] = selected[k] || (*selections)[producer][k];
+                }
+            }
+
+            std::vector<T>& column = columns[index];
+            if(begin == 0) column.assign(block.size(), T());
+            TBranch* branch = branches[index];
+            const T& value = values[index];
+            const Long64_t first_entry = block.first_entry();
+            for(size_t k = begin; k < end; k++)
+            {
+                if(!selected[k]) continue;
+                if(branch->GetEntry(first_entry + k) < 0)
+                {
+                    throw std::runtime_error("Could not read entry " + std::to_string(first_entry + k) + " of branch " + branch->GetName() + ".");
+                }
+                column[k] = value;
+            }
+            if(selections)
+            {
+                const size_t n_selected = std::count(selected.begin() + begin, selected.begin() + end, true);
+                n_selected_ += n_selected;
+                n_skipped_ += end - begin - n_selected;
+            }
+        }
+    }
+
+    TTree* tree_;
+    const InputSchema& schema_;
+    // Whether the trees have TTreeCaches, which are filled by cluster
+    bool cached_;
+    ColumnTuple<BranchPointers> branches_;
+    // Addresses of the branches, to which the values of the current entry are read
+    ColumnTuple<ValueList> values_;
+    size_t n_selected_;
+    size_t n_skipped_;
+    // Declared branches of the input tree and of each friend tree
+    std::map<TTree*, std::vector<std::string>> tree_branches_;
+    // Files of the trees with their read calls and bytes read before the task
+    std::map<TFile*, std::pair<Long64_t, Long64_t>> files_;
+};
+
+#endif
@@ -0,0 +1,164 @@
+#ifndef FRIEND_TREE_PRODUCER_CORRECTIONWEIGHTSPRODUCER_H
+#define FRIEND_TREE_PRODUCER_CORRECTIONWEIGHTSPRODUCER_H
+
+#include "TFile.h"
+#include "TH1.h"
+
+#include <boost/algorithm/string.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+#include "HiggsAnalysis/friend-tree-producer/interface/FriendProducer.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/WeightMap.h"
+
+// Configuration of a single correction weight, looked up in a TH1, TH2 or TH3
+struct CorrectionWeight
+{
+    // Name of the output branch
+    std::string name;
+    // ROOT file relative to the weight directory, with {year} replaced by the year of the sample
+    std::string file;
+    std::string histogram;
+    // Input branches, one per dimension of the histogram
+    std::vector<std::string> variables;
+    // Values beyond the last bin edge use the last bin instead of the overflow bin
+    bool clamp_overflow = false;
+    // Weight of events with a variable below its minimum
+    Float_t default_weight = 1.0;
+    std::vector<std::pair<std::string, Float_t>> minimum;
+};
+
+// Reads a list of correction weights from a json file of the form
+// {"weights": [{"name": ..., "file": ..., "histogram": ..., "variables": [...], "clamp_overflow": ..., "default": ..., "minimum": {<variable>: <value>}}]}
+inline std::vector<CorrectionWeight> read_correction_weights(const std::string& config)
+{
+    boost::property_tree::ptree config_json;
+    boost::property_tree::json_parser::read_json(config, config_json);
+    std::vector<CorrectionWeight> weights;
+    for(const auto& entry : config_json.get_child("weights"))
+    {
+        const boost::property_tree::ptree& weight_json = entry.second;
+        CorrectionWeight weight;
+        weight.name = weight_json.get<std::string>("name");
+        weight.file = weight_json.get<std::string>("file");
+        weight.histogram = weight_json.get<std::string>("histogram");
+        for(const auto& variable : weight_json.get_child("variables")) weight.variables.push_back(variable.second.get_value<std::string>());
+        weight.clamp_overflow = weight_json.get<bool>("clamp_overflow", false);
+        weight.default_weight = weight_json.get<Float_t>("default", 1.0);
+        if(weight_json.count("minimum") > 0)
+        {
+            for(const auto& minimum : weight_json.get_child("minimum")) weight.minimum.emplace_back(minimum.first, minimum.second.get_value<Float_t>());
+        }
+        weights.push_back(weight);
+    }
+    return weights;
+}
+
+// Correction weights from any number of histograms, evaluated for all weights in one pass over each block.
+// The histograms are compiled into WeightMaps once per file for all tasks of the producer.
+class CorrectionWeightsProducer : public FriendProducer
+{
+  public:
+    CorrectionWeightsProducer(const std::vector<CorrectionWeight>& weights, const std::string& datasets, const std::string& weight_directory,
+                              const std::string& name = "CorrectionWeights", const std::string& title = "Correction weight friend tree")
+        : weights_(weights), datasets_(datasets), weight_directory_(weight_directory), name_(name), title_(title)
+    {
+    }
+
+    std::string name() const override { return name_; }
+    std::string title() const override { return title_; }
+
+    void declare(const ProducerTask& task, InputSchema& inputs, OutputSchema& outputs) override
+    {
+        lookups_.clear();
+        for(const auto& weight : weights_)
+        {
+            Lookup lookup;
+            lookup.map = &weight_map(resolve_file(weight.file, task), weight);
+            if(lookup.map->dimension() != weight.variables.size())
+            {
+                throw std::runtime_error("Histogram " + weight.histogram + " of weight " + weight.name + " has " + std::to_string(lookup.map->dimension()) + " dimensions, but " + std::to_string(weight.variables.size()) + " variables are given.");
+            }
+            for(const auto& variable : weight.variables) lookup.variables.push_back(inputs.add<Float_t>(variable));
+            for(const auto& minimum : weight.minimum) lookup.minimum.emplace_back(inputs.add<Float_t>(minimum.first), minimum.second);
+            lookup.output = outputs.add(weight.name);
+            lookups_.push_back(lookup);
+        }
+    }
+
+    void compute(const InputBlock& inputs, const std::vector<bool>& selected, OutputBlock& outputs) override
+    {
+        std::vector<const std::vector<Float_t>*> values;
+        for(size_t w = 0; w < lookups_.size(); w++)
+        {
+            const Lookup& lookup = lookups_[w];
+            values.clear();
+            for(const auto& variable : lookup.variables) values.push_back(&inputs.get(variable));
+            lookup.map->evaluate(values, block_weights_);
+
+            // No correction for events below the minimum of a variable
+            for(const auto& minimum : lookup.minimum)
+            {
+                const std::vector<Float_t>& column = inputs.get(minimum.first);
+                for(size_t k = 0; k < inputs.size(); k++) block_weights_[k] = column[k] >= minimum.second ? block_weights_[k] : weights_[w].default_weight;
+            }
+            for(size_t k = 0; k < inputs.size(); k++) outputs.set(lookup.output, k, block_weights_[k]);
+        }
+    }
+
+  private:
+    struct Lookup
+    {
+        WeightMap* map;
+        std::vector<InputColumn<Float_t>> variables;
+        std::vector<std::pair<InputColumn<Float_t>, Float_t>> minimum;
+        OutputColumn output;
+    };
+
+    std::string resolve_file(const std::string& file, const ProducerTask& task)
+    {
+        if(file.find("{year}") == std::string::npos) return weight_directory_ + file;
+
+        // Load datasets.json to determine year of the sample per nick
+        if(datasets_json_.empty()) boost::property_tree::json_parser::read_json(datasets_, datasets_json_);
+        std::vector<std::string> input_split;
+        boost::split(input_split, task.input, boost::is_any_of("/"));
+        std::string nick = input_split.end()[-2];
+        int year = datasets_json_.get_child(nick).get<int>("year");
+        return weight_directory_ + boost::replace_all_copy(file, "{year}", std::to_string(year));
+    }
+
+    WeightMap& weight_map(const std::string& filename, const CorrectionWeight& weight)
+    {
+        std::unique_ptr<WeightMap>& map = weight_maps_[std::make_pair(filename + ":" + weight.histogram, weight.clamp_overflow)];
+        if(!map)
+        {
+            std::unique_ptr<TFile> weight_file(TFile::Open(filename.c_str(), "read"));
+            if(!weight_file || weight_file->IsZombie()) throw std::runtime_error("Could not open weight file " + filename + ".");
+            TH1* histogram = dynamic_cast<TH1*>(weight_file->Get(weight.histogram.c_str()));
+            if(!histogram) throw std::runtime_error("Could not find histogram " + weight.histogram + " in " + filename + ".");
+            map.reset(new WeightMap(*histogram, weight.clamp_overflow));
+            weight_file->Close();
+        }
+        return *map;
+    }
+
+    std::vector<CorrectionWeight> weights_;
+    std::string datasets_;
+    std::string weight_directory_;
+    std::string name_;
+    std::string title_;
+    boost::property_tree::ptree datasets_json_;
+    std::map<std::pair<std::string, bool>, std::unique_ptr<WeightMap>> weight_maps_;
+
+    std::vector<Lookup> lookups_;
+    std::vector<Float_t> block_weights_;
+};
+
+#endif
@@ -0,0 +1,660 @@
+#ifndef FRIEND_TREE_PRODUCER_DENSENETWORK_H
+#define FRIEND_TREE_PRODUCER_DENSENETWORK_H
+
+#include "lwtnn/LightweightGraph.hh"
+#include "lwtnn/parse_json.hh"
+
+#include <Eigen/Dense>
+
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "HiggsAnalysis/friend-tree-producer/interface/MappedFile.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/NeuralNetwork.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/SimdKernels.h"
+
+// Depending on the lwtnn version, the activation of a layer is given either directly or with parameters
+inline lwt::Activation activation_function(lwt::Activation activation) { return activation; }
+template <typename ActivationConfig>
+lwt::Activation activation_function(const ActivationConfig& activation) { return activation.function; }
+inline double activation_alpha(lwt::Activation activation) { return activation == lwt::Activation::ELU ? 1.0 : 0.3; }
+template <typename ActivationConfig>
+double activation_alpha(const ActivationConfig& activation) { return activation.alpha; }
+
+// Activation functions supported by DenseNetwork, in the order of their codes in compiled networks
+const std::vector<lwt::Activation> dense_network_activations = {lwt::Activation::NONE, lwt::Activation::LINEAR, lwt::Activation::SIGMOID, lwt::Activation::RECTIFIED, lwt::Activation::TANH,
+                                                                lwt::Activation::HARD_SIGMOID, lwt::Activation::ELU, lwt::Activation::LEAKY_RELU, lwt::Activation::SWISH, lwt::Activation::SOFTMAX};
+
+// Applies the activation function of a layer to a matrix of outputs with one column per event,
+// using the same conventions as the lwtnn layers.
+inline void apply_activation(Eigen::MatrixXd& values, lwt::Activation activation, double alpha)
+{
+    switch(activation)
+    {
+        case lwt::Activation::NONE:
+        case lwt::Activation::LINEAR:
+            break;
+        case lwt::Activation::SIGMOID:
+            values = values.unaryExpr([](double x) { return x < -30.0 ? 0.0 : (x > 30.0 ? 1.0 : 1.0 / (1.0 + std::exp(-x))); });
+            break;
+        case lwt::Activation::RECTIFIED:
+            values = values.cwiseMax(0.0);
+            break;
+        case lwt::Activation::TANH:
+            values = values.array().tanh();
+            break;
+        case lwt::Activation::HARD_SIGMOID:
+            values = (0.2 * values.array() + 0.5).cwiseMax(0.0).cwiseMin(1.0);
+            break;
+        case lwt::Activation::ELU:
+            values = values.unaryExpr([alpha](double x) { return x > 0.0 ? x : alpha * (std::exp(x) - 1.0); });
+            break;
+        case lwt::Activation::LEAKY_RELU:
+            values = values.unaryExpr([alpha](double x) { return x > 0.0 ? x : alpha * x; });
+            break;
+        case lwt::Activation::SWISH:
+            values = values.unaryExpr([alpha](double x) { return x / (1.0 + std::exp(-alpha * x)); });
+            break;
+        case lwt::Activation::SOFTMAX:
+            for(Eigen::Index event = 0; event < values.cols(); event++)
+            {
+                // lwtnn subtracts the maximum in single precision for numerical stability
+                const float max = values.col(event).maxCoeff();
+                values.col(event) = (values.col(event).array() - max).exp();
+                values.col(event) /= values.col(event).sum();
+            }
+            break;
+        default:
+            throw std::runtime_error("Activation function not supported by DenseNetwork.");
+    }
+}
+
+// Single precision version of apply_activation for values with one row per output and the events contiguous within each row
+inline void apply_activation(float* values, size_t n_rows, size_t n_events, lwt::Activation activation, float alpha)
+{
+    const size_t n_values = n_rows * n_events;
+    switch(activation)
+    {
+        case lwt::Activation::NONE:
+        case lwt::Activation::LINEAR:
+            break;
+        case lwt::Activation::SIGMOID:
+            for(size_t n = 0; n < n_values; n++) values[n] = values[n] < -30.0f ? 0.0f : (values[n] > 30.0f ? 1.0f : 1.0f / (1.0f + std::exp(-values[n])));
+            break;
+        case lwt::Activation::RECTIFIED:
+            for(size_t n = 0; n < n_values; n++) values[n] = std::max(values[n], 0.0f);
+            break;
+        case lwt::Activation::TANH:
+            for(size_t n = 0; n < n_values; n++) values[n] = std::tanh(values[n]);
+            break;
+        case lwt::Activation::HARD_SIGMOID:
+            for(size_t n = 0; n < n_values; n++) values[n] = std::min(1.0f, std::max(0.0f, 0.2f * values[n] + 0.5f));
+            break;
+        case lwt::Activation::ELU:
+            for(size_t n = 0; n < n_values; n++) values[n] = values[n] > 0.0f ? values[n] : alpha * (std::exp(values[n]) - 1.0f);
+            break;
+        case lwt::Activation::LEAKY_RELU:
+            for(size_t n = 0; n < n_values; n++) values[n] = values[n] > 0.0f ? values[n] : alpha * values[n];
+            break;
+        case lwt::Activation::SWISH:
+            for(size_t n = 0; n < n_values; n++) values[n] = values[n] / (1.0f + std::exp(-alpha * values[n]));
+            break;
+        case lwt::Activation::SOFTMAX:
+            for(size_t k = 0; k < n_events; k++)
+            {
+                float max = values[k];
+                for(size_t r = 1; r < n_rows; r++) max = std::max(max, values[r * n_events + k]);
+                float sum = 0.0f;
+                for(size_t r = 0; r < n_rows; r++)
+                {
+                    values[r * n_events + k] = std::exp(values[r * n_events + k] - max);
+                    sum += values[r * n_events + k];
+                }
+                for(size_t r = 0; r < n_rows; r++) values[r * n_events + k] /= sum;
+            }
+            break;
+        default:
+            throw std::runtime_error("Activation function not supported by DenseNetwork.");
+    }
+}
+
+// Arithmetic used by DenseNetwork::compute()
+enum class NetworkPrecision { Double, Float, Int8 };
+
+inline NetworkPrecision network_precision(const std::string& name)
+{
+    if(name == "double") return NetworkPrecision::Double;
+    if(name == "float") return NetworkPrecision::Float;
+    if(name == "int8") return NetworkPrecision::Int8;
+    throw std::runtime_error("Unknown network precision " + name + ", expected double, float or int8.");
+}
+
+// Feed-forward network built from an lwtnn configuration, which evaluates a whole batch of
+// events at once with matrix-matrix products instead of one std::map of inputs per event.
+//
+// The weights and biases of all layers are stored in one contiguous array, each aligned to 64 bytes.
+// A network can be compiled with save() into a binary file, which is mapped into memory by load()
+// without parsing, such that the weights are shared through the page cache by all jobs on a node.
+//
+// By default, the network is evaluated in double precision like lwtnn. With set_precision(), the dense layers are
+// evaluated in single precision or on int8-quantized inputs and weights instead, on the SIMD kernels of SimdKernels.h.
+//
+// Compiled format, version 2, all integers uint64 in native byte order:
+//   "FTPDNN01", version, number of inputs, outputs, nodes and data words, output node,
+//   names: length and characters of each input name and output label, and of the name of the graph output node
+//          the network was compiled for (empty for sequential networks),
+//   nodes: type, input offset, number of outputs, sources and layers, the sources, and per layer
+//          its type, activation code, alpha (as double), inputs, outputs, weights offset and bias offset,
+//   padding to 64 bytes, data: input offsets, input scales, weights and biases as doubles.
+class DenseNetwork : public NeuralNetwork
+{
+  public:
+    static constexpr uint64_t format_version = 2;
+
+    // Network for the output node of an lwtnn graph. The inputs of all input nodes are concatenated.
+    DenseNetwork(const lwt::GraphConfig& config, const std::string& output_node)
+    {
+        auto output = config.outputs.find(output_node);
+        if(output == config.outputs.end()) throw std::runtime_error("Output node " + output_node + " not found in lwtnn graph.");
+        output_labels_ = output->second.labels;
+        output_node_name_ = output_node;
+
+        // Collect the inputs of all input nodes
+        std::vector<size_t> input_offsets;
+        for(const auto& input_node : config.inputs)
+        {
+            input_offsets.push_back(input_names_.size());
+            for(const auto& variable : input_node.variables) add_input(variable);
+        }
+
+        // Translate the nodes of the graph
+        for(const auto& node_config : config.nodes)
+        {
+            Node node;
+            node.sources.assign(node_config.sources.begin(), node_config.sources.end());
+            if(node_config.type == lwt::NodeConfig::Type::INPUT)
+            {
+                node.type = Node::Input;
+                const size_t input_number = node_config.sources.at(0);
+                node.input_offset = input_offsets.at(input_number);
+                node.n_outputs = config.inputs.at(input_number).variables.size();
+                node.sources.clear();
+            }
+            else if(node_config.type == lwt::NodeConfig::Type::FEED_FORWARD)
+            {
+                node.type = Node::FeedForward;
+                node.layers.push_back(make_layer(config.layers.at(node_config.index), nodes_.at(node.sources.at(0)).n_outputs));
+                node.n_outputs = node.layers.back().n_outputs;
+            }
+            else if(node_config.type == lwt::NodeConfig::Type::CONCATENATE)
+            {
+                node.type = Node::Concatenate;
+                node.n_outputs = 0;
+                for(auto source : node.sources) node.n_outputs += nodes_.at(source).n_outputs;
+            }
+            else
+            {
+                throw std::runtime_error("Only input, feed-forward and concatenation nodes are supported by DenseNetwork.");
+            }
+            nodes_.push_back(node);
+        }
+        output_node_ = output->second.node_index;
+        if(nodes_.at(output_node_).n_outputs != output_labels_.size()) throw std::runtime_error("Number of output labels does not match the output node " + output_node + ".");
+        data_ = storage_.data();
+    }
+
+    // Network of a sequential lwtnn configuration
+    explicit DenseNetwork(const lwt::JSONConfig& config)
+    {
+        output_labels_ = config.outputs;
+        for(const auto& variable : config.inputs) add_input(variable);
+
+        Node input_node;
+        input_node.type = Node::Input;
+        input_node.input_offset = 0;
+        input_node.n_outputs = n_inputs();
+        nodes_.push_back(input_node);
+
+        Node stack;
+        stack.type = Node::FeedForward;
+        stack.sources.push_back(0);
+        stack.n_outputs = n_inputs();
+        for(const auto& layer : config.layers)
+        {
+            stack.layers.push_back(make_layer(layer, stack.n_outputs));
+            stack.n_outputs = stack.layers.back().n_outputs;
+        }
+        nodes_.push_back(stack);
+        output_node_ = 1;
+        if(stack.n_outputs != output_labels_.size()) throw std::runtime_error("Number of output labels does not match the lwtnn network.");
+        data_ = storage_.data();
+    }
+
+    // The layers refer to the weights of this network, which are not copied
+    DenseNetwork(const DenseNetwork&) = delete;
+    DenseNetwork& operator=(const DenseNetwork&) = delete;
+
+    void compute(const Eigen::MatrixXd& inputs, Eigen::MatrixXd& outputs) const override
+    {
+        if(static_cast<size_t>(inputs.rows()) != n_inputs()) throw std::runtime_error("Wrong number of inputs given to DenseNetwork.");
+        if(precision_ != NetworkPrecision::Double)
+        {
+            compute_reduced(inputs, outputs);
+            return;
+        }
+        Eigen::MatrixXd scaled = (inputs.colwise() + input_offsets_).array().colwise() * input_scales_.array();
+        std::vector<Eigen::MatrixXd> values(nodes_.size());
+        std::vector<bool> computed(nodes_.size(), false);
+        outputs = evaluate(output_node_, scaled, values, computed);
+    }
+
+    // Selects the arithmetic of compute(). For Float and Int8, single precision copies of the weights are prepared,
+    // and for Int8 the weights of the dense layers are quantized symmetrically per output row.
+    void set_precision(NetworkPrecision precision)
+    {
+        precision_ = precision;
+        for(auto& node : nodes_)
+        {
+            for(auto& layer : node.layers)
+            {
+                const size_t n_weights = layer.type == Layer::Dense ? layer.n_inputs * layer.n_outputs : layer.n_outputs;
+                layer.float_weights.assign(data_ + layer.weights_offset, data_ + layer.weights_offset + n_weights);
+                layer.float_bias.assign(data_ + layer.bias_offset, data_ + layer.bias_offset + layer.n_outputs);
+                layer.int8_weights.clear();
+                layer.weight_scales.clear();
+                if(precision != NetworkPrecision::Int8 || layer.type != Layer::Dense) continue;
+                layer.int8_weights.resize(n_weights);
+                layer.weight_scales.resize(layer.n_outputs);
+                for(size_t o = 0; o < layer.n_outputs; o++)
+                {
+                    const double* row = data_ + layer.weights_offset + o * layer.n_inputs;
+                    double max = 0.0;
+                    for(size_t i = 0; i < layer.n_inputs; i++) max = std::max(max, std::fabs(row[i]));
+                    const double scale = max > 0.0 ? max / 127.0 : 1.0;
+                    layer.weight_scales[o] = scale;
+                    for(size_t i = 0; i < layer.n_inputs; i++) layer.int8_weights[o * layer.n_inputs + i] = static_cast<int8_t>(std::lround(row[i] / scale));
+                }
+            }
+        }
+    }
+
+    NetworkPrecision precision() const { return precision_; }
+
+    // Output node of the lwtnn graph the network was built for, empty for sequential networks
+    const std::string& output_node_name() const { return output_node_name_; }
+
+    // Writes the network in the compiled binary format
+    void save(const std::string& path) const
+    {
+        std::ofstream file(path, std::ios::binary);
+        if(!file) throw std::runtime_error("Could not write " + path + ".");
+        file.write("FTPDNN01", 8);
+        for(uint64_t value : {format_version, uint64_t(n_inputs()), uint64_t(n_outputs()), uint64_t(nodes_.size()), uint64_t(data_size_), uint64_t(output_node_)}) write_word(file, value);
+        const std::vector<std::string> output_node_names = {output_node_name_};
+        for(const auto& names : {&input_names_, &output_labels_, &output_node_names})
+        {
+            for(const auto& name : *names)
+            {
+                write_word(file, name.size());
+                file.write(name.data(), name.size());
+            }
+        }
+        for(const auto& node : nodes_)
+        {
+            for(uint64_t value : {uint64_t(node.type), uint64_t(node.input_offset), uint64_t(node.n_outputs), uint64_t(node.sources.size()), uint64_t(node.layers.size())}) write_word(file, value);
+            for(auto source : node.sources) write_word(file, source);
+            for(const auto& layer : node.layers)
+            {
+                uint64_t alpha;
+                std::memcpy(&alpha, &layer.alpha, sizeof(alpha));
+                const uint64_t activation = std::find(dense_network_activations.begin(), dense_network_activations.end(), layer.activation) - dense_network_activations.begin();
+                for(uint64_t value : {uint64_t(layer.type), activation, alpha, uint64_t(layer.n_inputs), uint64_t(layer.n_outputs), uint64_t(layer.weights_offset), uint64_t(layer.bias_offset)}) write_word(file, value);
+            }
+        }
+        const std::streamoff position = file.tellp();
+        const std::vector<char> padding((alignment - position % alignment) % alignment, 0);
+        file.write(padding.data(), padding.size());
+        file.write(reinterpret_cast<const char*>(input_offsets_.data()), n_inputs() * sizeof(double));
+        file.write(reinterpret_cast<const char*>(input_scales_.data()), n_inputs() * sizeof(double));
+        file.write(reinterpret_cast<const char*>(data_), data_size_ * sizeof(double));
+        if(!file) throw std::runtime_error("Could not write " + path + ".");
+    }
+
+    // Maps a network in the compiled binary format into memory. The weights are used in place.
+    static std::unique_ptr<DenseNetwork> load(const std::string& path)
+    {
+        std::unique_ptr<DenseNetwork> network(new DenseNetwork());
+        network->mapped_.reset(new MappedFile(path));
+        const char* begin = network->mapped_->data();
+        const char* end = begin + network->mapped_->size();
+        const char* position = begin;
+        auto read_word = [&]() {
+            if(end - position < 8) throw std::runtime_error("Compiled network " + path + " is truncated.");
+            uint64_t value;
+            std::memcpy(&value, position, sizeof(value));
+            position += sizeof(value);
+            return value;
+        };
+        auto read_name = [&]() {
+            const uint64_t length = read_word();
+            if(uint64_t(end - position) < length) throw std::runtime_error("Compiled network " + path + " is truncated.");
+            std::string name(position, length);
+            position += length;
+            return name;
+        };
+
+        if(network->mapped_->size() < 8 || std::string(position, 8) != "FTPDNN01") throw std::runtime_error(path + " is not a compiled network.");
+        position += 8;
+        if(read_word() != format_version) throw std::runtime_error("Compiled network " + path + " has an unsupported format version, please recompile it with CompileNetworks.");
+        const uint64_t n_inputs = read_word();
+        const uint64_t n_outputs = read_word();
+        const uint64_t n_nodes = read_word();
+        network->data_size_ = read_word();
+        network->output_node_ = read_word();
+        for(uint64_t n = 0; n < n_inputs; n++) network->input_names_.push_back(read_name());
+        for(uint64_t n = 0; n < n_outputs; n++) network->output_labels_.push_back(read_name());
+        network->output_node_name_ = read_name();
+        for(uint64_t index = 0; index < n_nodes; index++)
+        {
+            Node node;
+            node.type = static_cast<Node::Type>(read_word());
+            node.input_offset = read_word();
+            node.n_outputs = read_word();
+            const uint64_t n_sources = read_word();
+            const uint64_t n_layers = read_word();
+            for(uint64_t source = 0; source < n_sources; source++) node.sources.push_back(read_word());
+            for(uint64_t n = 0; n < n_layers; n++)
+            {
+                Layer layer;
+                layer.type = static_cast<Layer::Type>(read_word());
+                layer.activation = dense_network_activations.at(read_word());
+                const uint64_t alpha = read_word();
+                std::memcpy(&layer.alpha, &alpha, sizeof(alpha));
+                layer.n_inputs = read_word();
+                layer.n_outputs = read_word();
+                layer.weights_offset = read_word();
+                layer.bias_offset = read_word();
+                const size_t n_weights = layer.type == Layer::Dense ? layer.n_outputs * layer.n_inputs : layer.n_outputs;
+                if(layer.weights_offset + n_weights > network->data_size_ || layer.bias_offset + layer.n_outputs > network->data_size_)
+                {
+                    throw std::runtime_error("Compiled network " + path + " is inconsistent.");
+                }
+                node.layers.push_back(layer);
+            }
+            network->nodes_.push_back(node);
+        }
+        position += (alignment - (position - begin) % alignment) % alignment;
+        if(uint64_t(end - position) != (2 * n_inputs + network->data_size_) * sizeof(double) || network->output_node_ >= n_nodes)
+        {
+            throw std::runtime_error("Compiled network " + path + " is inconsistent.");
+        }
+        const double* data = reinterpret_cast<const double*>(position);
+        network->input_offsets_ = Eigen::Map<const Eigen::VectorXd>(data, n_inputs);
+        network->input_scales_ = Eigen::Map<const Eigen::VectorXd>(data + n_inputs, n_inputs);
+        network->data_ = data + 2 * n_inputs;
+        return network;
+    }
+
+  private:
+    static constexpr size_t alignment = 64;
+
+    struct Layer
+    {
+        enum Type { Dense, Normalization };
+        Type type;
+        // Offsets of the weights and the bias within the data of the network. The weights of dense layers
+        // are stored row-wise with one row per output, as in lwtnn.
+        size_t weights_offset;
+        size_t bias_offset;
+        lwt::Activation activation;
+        double alpha;
+        size_t n_inputs;
+        size_t n_outputs;
+        // Copies of the weights for the reduced precisions, prepared by set_precision()
+        std::vector<float> float_weights;
+        std::vector<float> float_bias;
+        std::vector<int8_t> int8_weights;
+        std::vector<float> weight_scales;
+    };
+
+    struct Node
+    {
+        enum Type { Input, FeedForward, Concatenate };
+        Type type;
+        std::vector<size_t> sources;
+        std::vector<Layer> layers;
+        size_t input_offset = 0;
+        size_t n_outputs;
+    };
+
+    typedef Eigen::Map<const Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>> WeightMatrix;
+
+    DenseNetwork() {}
+
+    static void write_word(std::ofstream& file, uint64_t value) { file.write(reinterpret_cast<const char*>(&value), sizeof(value)); }
+
+    void add_input(const lwt::Input& variable)
+    {
+        input_names_.push_back(variable.name);
+        input_offsets_.conservativeResize(input_names_.size());
+        input_scales_.conservativeResize(input_names_.size());
+        input_offsets_(input_names_.size() - 1) = variable.offset;
+        input_scales_(input_names_.size() - 1) = variable.scale;
+    }
+
+    // Appends values to the data of the network, aligned to 64 bytes, and returns their offset
+    size_t add_data(const std::vector<double>& values)
+    {
+        const size_t words = alignment / sizeof(double);
+        storage_.resize((storage_.size() + words - 1) / words * words, 0.0);
+        const size_t offset = storage_.size();
+        storage_.insert(storage_.end(), values.begin(), values.end());
+        data_size_ = storage_.size();
+        return offset;
+    }
+
+    Layer make_layer(const lwt::LayerConfig& config, size_t n_inputs)
+    {
+        Layer layer;
+        layer.activation = activation_function(config.activation);
+        layer.alpha = activation_alpha(config.activation);
+        if(std::find(dense_network_activations.begin(), dense_network_activations.end(), layer.activation) == dense_network_activations.end())
+        {
+            throw std::runtime_error("Activation function not supported by DenseNetwork.");
+        }
+        layer.n_inputs = n_inputs;
+        if(config.architecture == lwt::Architecture::DENSE)
+        {
+            layer.type = Layer::Dense;
+            layer.n_outputs = config.weights.size() / n_inputs;
+            if(layer.n_outputs * n_inputs != config.weights.size() || config.bias.size() != layer.n_outputs) throw std::runtime_error("Inconsistent dense layer in lwtnn configuration.");
+        }
+        else if(config.architecture == lwt::Architecture::NORMALIZATION)
+        {
+            layer.type = Layer::Normalization;
+            layer.n_outputs = n_inputs;
+            if(config.weights.size() != n_inputs || config.bias.size() != n_inputs) throw std::runtime_error("Inconsistent normalization layer in lwtnn configuration.");
+        }
+        else
+        {
+            throw std::runtime_error("Only dense and normalization layers are supported by DenseNetwork.");
+        }
+        layer.weights_offset = add_data(config.weights);
+        layer.bias_offset = add_data(config.bias);
+        return layer;
+    }
+
+    const Eigen::MatrixXd& evaluate(size_t index, const Eigen::MatrixXd& inputs, std::vector<Eigen::MatrixXd>& values, std::vector<bool>& computed) const
+    {
+        if(computed[index]) return values[index];
+        const Node& node = nodes_[index];
+        if(node.type == Node::Input)
+        {
+            values[index] = inputs.middleRows(node.input_offset, node.n_outputs);
+        }
+        else if(node.type == Node::FeedForward)
+        {
+            values[index] = evaluate(node.sources.at(0), inputs, values, computed);
+            for(const auto& layer : node.layers)
+            {
+                Eigen::Map<const Eigen::VectorXd> bias(data_ + layer.bias_offset, layer.n_outputs);
+                if(layer.type == Layer::Dense)
+                {
+                    Eigen::MatrixXd product = WeightMatrix(data_ + layer.weights_offset, layer.n_outputs, layer.n_inputs) * values[index];
+                    values[index] = product.colwise() + bias;
+                }
+                else
+                {
+                    Eigen::Map<const Eigen::VectorXd> weights(data_ + layer.weights_offset, layer.n_outputs);
+                    // As lwtnn's NormalizationLayer: W * (x + b) element-wise
+                    values[index] = (values[index].array().colwise() + bias.array()).colwise() * weights.array();
+                }
+                apply_activation(values[index], layer.activation, layer.alpha);
+            }
+        }
+        else
+        {
+            values[index].resize(node.n_outputs, inputs.cols());
+            size_t row = 0;
+            for(auto source : node.sources)
+            {
+                const Eigen::MatrixXd& source_values = evaluate(source, inputs, values, computed);
+                values[index].middleRows(row, source_values.rows()) = source_values;
+                row += source_values.rows();
+            }
+        }
+        computed[index] = true;
+        return values[index];
+    }
+
+    // Evaluation in reduced precision, on values with one row per feature and the events contiguous within each row
+    void compute_reduced(const Eigen::MatrixXd& inputs, Eigen::MatrixXd& outputs) const
+    {
+        const size_t n_events = inputs.cols();
+        std::vector<float> scaled(n_inputs() * n_events);
+        for(size_t k = 0; k < n_events; k++)
+        {
+            for(size_t i = 0; i < n_inputs(); i++) scaled[i * n_events + k] = (inputs(i, k) + input_offsets_(i)) * input_scales_(i);
+        }
+        std::vector<std::vector<float>> values(nodes_.size());
+        std::vector<bool> computed(nodes_.size(), false);
+        const std::vector<float>& result = evaluate_reduced(output_node_, scaled, n_events, values, computed);
+        outputs.resize(n_outputs(), n_events);
+        for(size_t k = 0; k < n_events; k++)
+        {
+            for(size_t o = 0; o < n_outputs(); o++) outputs(o, k) = result[o * n_events + k];
+        }
+    }
+
+    const std::vector<float>& evaluate_reduced(size_t index, const std::vector<float>& inputs, size_t n_events, std::vector<std::vector<float>>& values,
+                                               std::vector<bool>& computed) const
+    {
+        if(computed[index]) return values[index];
+        const Node& node = nodes_[index];
+        std::vector<float>& result = values[index];
+        if(node.type == Node::Input)
+        {
+            result.assign(inputs.begin() + node.input_offset * n_events, inputs.begin() + (node.input_offset + node.n_outputs) * n_events);
+        }
+        else if(node.type == Node::FeedForward)
+        {
+            result = evaluate_reduced(node.sources.at(0), inputs, n_events, values, computed);
+            std::vector<float> layer_outputs, input_scales;
+            std::vector<int8_t> quantized;
+            std::vector<int32_t> accumulator;
+            for(const auto& layer : node.layers)
+            {
+                if(layer.type == Layer::Normalization)
+                {
+                    normalization_float(layer.float_weights.data(), layer.float_bias.data(), layer.n_outputs, result.data(), n_events);
+                }
+                else if(precision_ == NetworkPrecision::Int8)
+                {
+                    quantized.resize(layer.n_inputs * n_events);
+                    input_scales.resize(n_events);
+                    accumulator.resize(n_events);
+                    layer_outputs.resize(layer.n_outputs * n_events);
+                    quantize_int8(result.data(), layer.n_inputs, n_events, quantized.data(), input_scales.data());
+                    dense_int8(layer.int8_weights.data(), layer.weight_scales.data(), layer.float_bias.data(), layer.n_inputs, layer.n_outputs, quantized.data(),
+                               input_scales.data(), accumulator.data(), layer_outputs.data(), n_events);
+                    result.swap(layer_outputs);
+                }
+                else
+                {
+                    layer_outputs.resize(layer.n_outputs * n_events);
+                    dense_float(layer.float_weights.data(), layer.float_bias.data(), layer.n_inputs, layer.n_outputs, result.data(), layer_outputs.data(), n_events);
+                    result.swap(layer_outputs);
+                }
+                apply_activation(result.data(), layer.n_outputs, n_events, layer.activation, layer.alpha);
+            }
+        }
+        else
+        {
+            result.resize(node.n_outputs * n_events);
+            size_t offset = 0;
+            for(auto source : node.sources)
+            {
+                const std::vector<float>& source_values = evaluate_reduced(source, inputs, n_events, values, computed);
+                std::copy(source_values.begin(), source_values.end(), result.begin() + offset);
+                offset += source_values.size();
+            }
+        }
+        computed[index] = true;
+        return result;
+    }
+
+    Eigen::VectorXd input_offsets_;
+    Eigen::VectorXd input_scales_;
+    std::vector<Node> nodes_;
+    size_t output_node_;
+    std::string output_node_name_;
+
+    // Weights and biases of all layers, either in storage_ or in the mapped compiled network
+    std::vector<double> storage_;
+    std::unique_ptr<MappedFile> mapped_;
+    const double* data_ = nullptr;
+    size_t data_size_ = 0;
+    NetworkPrecision precision_ = NetworkPrecision::Double;
+};
+
+// Path of the compiled network of an lwtnn json file, e.g. fold0_lwtnn.dnn for fold0_lwtnn.json
+inline std::string compiled_network_path(const std::string& lwtnn_json)
+{
+    return boost::filesystem::path(lwtnn_json).replace_extension(".dnn").string();
+}
+
+// Loads the compiled network next to an lwtnn json file, if it is not older than the json file and was compiled for the given output node.
+// Otherwise, the json file is parsed as a graph with the given output node, or as a sequential network without output node.
+inline std::unique_ptr<DenseNetwork> load_dense_network(const std::string& lwtnn_json, const std::string& output_node = "")
+{
+    const std::string compiled = compiled_network_path(lwtnn_json);
+    if(boost::filesystem::exists(compiled))
+    {
+        const bool json_exists = boost::filesystem::exists(lwtnn_json);
+        if(!json_exists || boost::filesystem::last_write_time(compiled) >= boost::filesystem::last_write_time(lwtnn_json))
+        {
+            std::unique_ptr<DenseNetwork> network = DenseNetwork::load(compiled);
+            if(network->output_node_name() == output_node) return network;
+            const std::string message = "Compiled network " + compiled + " was compiled for output node \"" + network->output_node_name() + "\" instead of \"" + output_node + "\"";
+            if(!json_exists) throw std::runtime_error(message + ".");
+            std::cout << message << ", parsing the json file instead" << std::endl;
+        }
+        else std::cout << "Compiled network " << compiled << " is older than " << lwtnn_json << ", parsing the json file instead" << std::endl;
+    }
+    std::ifstream config_file(lwtnn_json);
+    if(!config_file) throw std::runtime_error("Could not read " + lwtnn_json + ".");
+    if(output_node == "") return std::unique_ptr<DenseNetwork>(new DenseNetwork(lwt::parse_json(config_file)));
+    return std::unique_ptr<DenseNetwork>(new DenseNetwork(lwt::parse_json_graph(config_file), output_node));
+}
+
+#endif
@@ -0,0 +1,247 @@
+#ifndef FRIEND_TREE_PRODUCER_FRIENDPRODUCER_H
+#define FRIEND_TREE_PRODUCER_FRIENDPRODUCER_H
+
+#include "TLeaf.h"
+#include "TTree.h"
+
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// Supported types of input branches
+template <typename T> const char* column_type_name();
+template <> inline const char* column_type_name<Float_t>() { return "Float_t"; }
+template <> inline const char* column_type_name<Double_t>() { return "Double_t"; }
+template <> inline const char* column_type_name<Int_t>() { return "Int_t"; }
+template <> inline const char* column_type_name<UInt_t>() { return "UInt_t"; }
+template <> inline const char* column_type_name<ULong64_t>() { return "ULong64_t"; }
+
+// One container per supported type, to store per-type lists of columns
+template <template <typename> class Container>
+using ColumnTuple = std::tuple<Container<Float_t>, Container<Double_t>, Container<Int_t>, Container<UInt_t>, Container<ULong64_t>>;
+
+template <typename T>
+using ColumnList = std::vector<std::vector<T>>;
+
+template <typename T>
+struct BranchList
+{
+    std::vector<std::string> names;
+    // Branches read for all entries, e.g. to select entries in FriendProducer::select()
+    std::vector<bool> all_entries;
+    // Producers, which need the branch for their selected entries
+    std::vector<std::vector<size_t>> selecting_producers;
+};
+
+// Handle of an input column of type T, as declared to an InputSchema
+template <typename T>
+struct InputColumn
+{
+    size_t index;
+};
+
+// Handle of a Float_t output column, as declared to an OutputSchema
+struct OutputColumn
+{
+    size_t index;
+};
+
+// Input branches needed by the producers of a job. Each branch is read once, even if several producers declare it.
+//
+// Branches declared with add() are read for all entries of a block. Branches declared with add_selected()
+// are read afterwards only for the entries selected by at least one of the producers declaring them,
+// which avoids decompressing them for entries that get default values anyway.
+class InputSchema
+{
+  public:
+    explicit InputSchema(TTree* tree) : tree_(tree), producer_(0) {}
+
+    // Index of the producer, which declares its inputs next
+    void set_producer(size_t producer) { producer_ = producer; }
+
+    template <typename T>
+    InputColumn<T> add(const std::string& branch)
+    {
+        BranchList<T>& branches = std::get<BranchList<T>>(branches_);
+        const size_t index = find_or_add<T>(branch);
+        branches.all_entries[index] = true;
+        return InputColumn<T>{index};
+    }
+
+    template <typename T>
+    InputColumn<T> add_selected(const std::string& branch)
+    {
+        BranchList<T>& branches = std::get<BranchList<T>>(branches_);
+        const size_t index = find_or_add<T>(branch);
+        branches.selecting_producers[index].push_back(producer_);
+        return InputColumn<T>{index};
+    }
+
+    // Type of a branch in the input tree or its friends, e.g. for inputs declared at runtime
+    std::string type_name(const std::string& branch) const
+    {
+        TLeaf* leaf = tree_->GetLeaf(branch.c_str());
+        if(!leaf) throw std::runtime_error("Branch " + branch + " not found in input tree.");
+        return leaf->GetTypeName();
+    }
+
+    template <typename T>
+    const std::vector<std::string>& branches() const { return std::get<BranchList<T>>(branches_).names; }
+
+    template <typename T>
+    bool all_entries(size_t index) const { return std::get<BranchList<T>>(branches_).all_entries[index]; }
+
+    template <typename T>
+    const std::vector<size_t>& selecting_producers(size_t index) const { return std::get<BranchList<T>>(branches_).selecting_producers[index]; }
+
+    TTree* tree() const { return tree_; }
+
+  private:
+    template <typename T>
+    size_t find_or_add(const std::string& branch)
+    {
+        BranchList<T>& branches = std::get<BranchList<T>>(branches_);
+        for(size_t index = 0; index < branches.names.size(); index++)
+        {
+            if(branches.names[index] == branch) return index;
+        }
+        const std::string type = type_name(branch);
+        if(type != column_type_name<T>())
+        {
+            throw std::runtime_error("Branch " + branch + " has type " + type + ", but is requested as " + column_type_name<T>() + ".");
+        }
+        branches.names.push_back(branch);
+        branches.all_entries.push_back(false);
+        branches.selecting_producers.emplace_back();
+        return branches.names.size() - 1;
+    }
+
+    TTree* tree_;
+    size_t producer_;
+    ColumnTuple<BranchList> branches_;
+};
+
+// Float_t output branches of a single producer
+class OutputSchema
+{
+  public:
+    OutputColumn add(const std::string& branch)
+    {
+        branches_.push_back(branch);
+        return OutputColumn{branches_.size() - 1};
+    }
+
+    const std::vector<std::string>& branches() const { return branches_; }
+
+  private:
+    std::vector<std::string> branches_;
+};
+
+// Values of the declared input branches for a block of consecutive entries, one array per branch.
+// Branches declared with InputSchema::add_selected() are zero for entries not selected by any of their producers.
+class InputBlock
+{
+  public:
+    template <typename T>
+    const std::vector<T>& get(InputColumn<T> column) const { return std::get<ColumnList<T>>(columns_)[column.index]; }
+
+    template <typename T>
+    ColumnList<T>& columns() { return std::get<ColumnList<T>>(columns_); }
+
+    Long64_t first_entry() const { return first_entry_; }
+    size_t size() const { return size_; }
+
+    void reset(Long64_t first_entry, size_t size)
+    {
+        first_entry_ = first_entry;
+        size_ = size;
+    }
+
+  private:
+    ColumnTuple<ColumnList> columns_;
+    Long64_t first_entry_ = 0;
+    size_t size_ = 0;
+};
+
+// Entries of a block to be written in the sparse output mode, with their run, lumi and event numbers
+struct SparseRows
+{
+    Long64_t first_entry = 0;
+    std::vector<bool> selected;
+    std::vector<UInt_t> run;
+    std::vector<UInt_t> lumi;
+    std::vector<ULong64_t> event;
+};
+
+// Output values of a single producer for a block of entries, one array per branch
+class OutputBlock
+{
+  public:
+    void reset(const OutputSchema& schema, size_t size)
+    {
+        columns_.resize(schema.branches().size());
+        for(auto& column : columns_) column.assign(size, 0.0);
+        size_ = size;
+    }
+
+    std::vector<Float_t>& get(OutputColumn column) { return columns_[column.index]; }
+    const std::vector<Float_t>& get(OutputColumn column) const { return columns_[column.index]; }
+    void set(OutputColumn column, size_t entry, Float_t value) { columns_[column.index][entry] = value; }
+    Float_t value(size_t column, size_t entry) const { return columns_[column][entry]; }
+
+    size_t size() const { return size_; }
+
+    SparseRows& sparse_rows() { return sparse_rows_; }
+    const SparseRows& sparse_rows() const { return sparse_rows_; }
+
+  private:
+    ColumnList<Float_t> columns_;
+    size_t size_ = 0;
+    SparseRows sparse_rows_;
+};
+
+// Settings of a single task: the entry range of one folder of an input file
+struct ProducerTask
+{
+    std::string input;
+    std::vector<std::string> input_friends;
+    std::string folder;
+    std::string tree;
+    Long64_t first_entry;
+    Long64_t last_entry; // included
+};
+
+// Common interface of the friend tree producers, such that several of them can be run on a single read of the input.
+//
+// For each task, declare() is called once to register the input branches and output branches of the producer.
+// Afterwards, compute() is called for consecutive blocks of entries and has to set all declared outputs
+// for every entry of the block. finish() is called after the last block of the task.
+//
+// Producers with a cheap precondition, e.g. on the number of jets, can declare the branches needed for the
+// precondition with InputSchema::add() and all other branches with InputSchema::add_selected(). For each block,
+// select() is then called with the branches read for all entries and has to unset the entries failing the
+// precondition, before the remaining branches are read for the selected entries only. compute() gets the selection
+// of the block, such that the precondition is not evaluated again, and has to set default outputs for unselected entries.
+class FriendProducer
+{
+  public:
+    virtual ~FriendProducer() {}
+
+    // Name of the producer, equal to the name of its standalone executable
+    virtual std::string name() const = 0;
+
+    // Title of the friend tree
+    virtual std::string title() const = 0;
+
+    // Settings of the producer, which are stored by name in the UserInfo of the friend tree
+    virtual std::map<std::string, std::string> metadata() const { return {}; }
+
+    virtual void declare(const ProducerTask& task, InputSchema& inputs, OutputSchema& outputs) = 0;
+    virtual void select(const InputBlock& inputs, std::vector<bool>& selected) const {}
+    virtual void compute(const InputBlock& inputs, const std::vector<bool>& selected, OutputBlock& outputs) = 0;
+    virtual void finish() {}
+};
+
+#endif
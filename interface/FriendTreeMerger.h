@@ -0,0 +1,160 @@
+#ifndef FRIEND_TREE_PRODUCER_FRIENDTREEMERGER_H
+#define FRIEND_TREE_PRODUCER_FRIENDTREEMERGER_H
+
+#include "TChain.h"
+#include "TFile.h"
+#include "TROOT.h"
+#include "TTree.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Chunks of the friend trees of one output file, for each folder in the order of the job outputs
+struct MergeTask
+{
+    std::string output;
+    std::string tree = "ntuple";
+    std::vector<std::pair<std::string, std::vector<std::string>>> folders;
+};
+
+// Reads the merge tasks from a json file of the form
+// {"tree": ..., "outputs": [{"output": ..., "folders": [{"folder": ..., "inputs": [...]}]}]}
+inline std::vector<MergeTask> read_merge_tasks(const std::string& config)
+{
+    boost::property_tree::ptree config_json;
+    boost::property_tree::json_parser::read_json(config, config_json);
+    const std::string tree = config_json.get<std::string>("tree", "ntuple");
+    std::vector<MergeTask> tasks;
+    for(const auto& output_entry : config_json.get_child("outputs"))
+    {
+        MergeTask task;
+        task.output = output_entry.second.get<std::string>("output");
+        task.tree = tree;
+        for(const auto& folder_entry : output_entry.second.get_child("folders"))
+        {
+            std::vector<std::string> inputs;
+            for(const auto& input : folder_entry.second.get_child("inputs")) inputs.push_back(input.second.get_value<std::string>());
+            task.folders.emplace_back(folder_entry.second.get<std::string>("folder"), inputs);
+        }
+        tasks.push_back(task);
+    }
+    return tasks;
+}
+
+// Concatenates the chunks of each folder into the output file. The chunks are cloned in "fast" mode,
+// which copies the compressed baskets without decompressing and recompressing them. Only the baskets
+// of the folder being copied are held in memory, since each merged tree is deleted after writing.
+// Returns the number of merged entries.
+inline Long64_t merge_friend_trees(const MergeTask& task)
+{
+    for(const auto& folder : task.folders)
+    {
+        for(const auto& input : folder.second)
+        {
+            if(!boost::filesystem::exists(input)) throw std::runtime_error("Input " + input + " of " + task.output + " does not exist.");
+        }
+    }
+    boost::filesystem::path output_path(task.output);
+    if(output_path.has_parent_path()) boost::filesystem::create_directories(output_path.parent_path());
+
+    // A failed merge leaves no output behind, which would be taken for a complete one
+    TFile* out = TFile::Open(task.output.c_str(), "recreate");
+    auto discard_output = [&out, &task]() {
+        if(out) out->Close();
+        delete out;
+        boost::system::error_code error;
+        boost::filesystem::remove(task.output, error);
+    };
+    if(!out || out->IsZombie())
+    {
+        discard_output();
+        throw std::runtime_error("Could not create " + task.output + ".");
+    }
+    Long64_t entries = 0;
+    for(const auto& folder : task.folders)
+    {
+        TChain chain((folder.first + "/" + task.tree).c_str());
+        for(const auto& input : folder.second) chain.Add(input.c_str());
+        const Long64_t chain_entries = chain.GetEntries();
+
+        out->mkdir(folder.first.c_str());
+        out->cd(folder.first.c_str());
+        TTree* merged = chain.CloneTree(-1, "fast");
+        if(!merged || merged->GetEntries() != chain_entries)
+        {
+            discard_output();
+            throw std::runtime_error("Could not merge " + folder.first + " of " + task.output + ".");
+        }
+        // Sparse outputs are indexed by run and event, which is rebuilt for the merged rows
+        if(chain_entries > 0 && merged->GetBranch("entry") && merged->GetBranch("run") && merged->GetBranch("event")) merged->BuildIndex("run", "event");
+        merged->Write("", TObject::kOverwrite);
+        delete merged;
+        entries += chain_entries;
+    }
+    out->Close();
+    delete out;
+    return entries;
+}
+
+// Merges the output files on the given number of threads, starting with the outputs with most input data,
+// such that the memory is bounded by the number of threads. Returns the number of failed outputs.
+inline size_t merge_friend_trees(std::vector<MergeTask> tasks, unsigned int threads)
+{
+    std::vector<uintmax_t> sizes(tasks.size(), 0);
+    for(size_t t = 0; t < tasks.size(); t++)
+    {
+        for(const auto& folder : tasks[t].folders)
+        {
+            for(const auto& input : folder.second)
+            {
+                boost::system::error_code error;
+                const uintmax_t size = boost::filesystem::file_size(input, error);
+                if(!error) sizes[t] += size;
+            }
+        }
+    }
+    std::vector<size_t> order(tasks.size());
+    for(size_t t = 0; t < order.size(); t++) order[t] = t;
+    std::stable_sort(order.begin(), order.end(), [&sizes](size_t a, size_t b) { return sizes[a] > sizes[b]; });
+
+    ROOT::EnableThreadSafety();
+    std::atomic<size_t> next(0);
+    std::atomic<size_t> failed(0);
+    std::mutex print_mutex;
+    auto worker = [&]() {
+        for(size_t n = next++; n < order.size(); n = next++)
+        {
+            const MergeTask& task = tasks[order[n]];
+            try
+            {
+                const Long64_t entries = merge_friend_trees(task);
+                std::lock_guard<std::mutex> lock(print_mutex);
+                std::cout << "Merged " << task.folders.size() << " folders with " << entries << " entries into " << task.output << std::endl;
+            }
+            catch(const std::exception& error)
+            {
+                failed++;
+                std::lock_guard<std::mutex> lock(print_mutex);
+                std::cerr << error.what() << std::endl;
+            }
+        }
+    };
+    std::vector<std::thread> workers;
+    for(unsigned int t = 0; t < std::max(1u, threads); t++) workers.emplace_back(worker);
+    for(auto& thread : workers) thread.join();
+    return failed;
+}
+
+#endif
@@ -0,0 +1,258 @@
+#ifndef FRIEND_TREE_PRODUCER_FRIENDTREERUNNER_H
+#define FRIEND_TREE_PRODUCER_FRIENDTREERUNNER_H
+
+#include "TDirectoryFile.h"
+#include "TFile.h"
+#include "TTree.h"
+
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <list>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "HiggsAnalysis/friend-tree-producer/interface/ColumnReader.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/FriendProducer.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/FriendTreeWriter.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/JobMetrics.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/Pipeline.h"
+
+// Input files and their friends, which are kept open across the tasks of a process.
+// After each task, the least recently used files beyond the capacity are closed.
+class InputFiles
+{
+  public:
+    explicit InputFiles(size_t capacity = 0) : capacity_(capacity) {}
+    ~InputFiles()
+    {
+        for(auto& file : files_)
+        {
+            file.second->Close();
+            delete file.second;
+        }
+    }
+
+    TFile* open(const std::string& path)
+    {
+        for(auto file = files_.begin(); file != files_.end(); ++file)
+        {
+            if(file->first == path)
+            {
+                files_.splice(files_.begin(), files_, file);
+                return files_.front().second;
+            }
+        }
+        TFile* file = TFile::Open(path.c_str(), "read");
+        if(!file || file->IsZombie())
+        {
+            delete file;
+            throw std::runtime_error("Could not open " + path + ".");
+        }
+        files_.emplace_front(path, file);
+        return file;
+    }
+
+    void release()
+    {
+        while(files_.size() > capacity_)
+        {
+            files_.back().second->Close();
+            delete files_.back().second;
+            files_.pop_back();
+        }
+    }
+
+  private:
+    size_t capacity_;
+    std::list<std::pair<std::string, TFile*>> files_;
+};
+
+// Input tree of a task and its friends, which are deleted after the task, also if it fails.
+// Further tasks on the same files read the trees again.
+struct TaskTrees
+{
+    TTree* input = nullptr;
+    std::vector<TTree*> friends;
+
+    ~TaskTrees()
+    {
+        delete input;
+        for(auto friendtree : friends) delete friendtree;
+    }
+};
+
+// Number of entries of the tree <folder>/<tree> in the input file
+inline Long64_t tree_entries(const std::string& input, const std::string& folder, const std::string& tree)
+{
+    TFile* in = TFile::Open(input.c_str(), "read");
+    if(!in || in->IsZombie())
+    {
+        delete in;
+        throw std::runtime_error("Could not open " + input + ".");
+    }
+    TTree* inputtree = (TTree*) in->Get((folder + "/" + tree).c_str());
+    const Long64_t entries = inputtree ? inputtree->GetEntries() : -1;
+    in->Close();
+    delete in;
+    if(entries < 0) throw std::runtime_error("Tree " + folder + "/" + tree + " not found in " + input + ".");
+    return entries;
+}
+
+// Writes the metrics of the output of one producer to a json file next to the output file
+inline void write_metrics(const std::string& outputname, const std::vector<FriendProducer*>& producers, size_t p, const ProducerTask& task,
+                          size_t events, const StageTimes& stages, Long64_t read_calls = 0, Long64_t bytes_read = 0)
+{
+    std::ofstream metrics(metrics_path(outputname));
+    if(!metrics) throw std::runtime_error("Could not write metrics of " + outputname + ".");
+    double total = 0.0;
+    for(const auto& stage : stages.stages())
+    {
+        if(stage.first == "total") total = stage.second;
+    }
+    metrics << "{\n";
+    metrics << "  \"producer\": " << json_string(producers[p]->name()) << ",\n";
+    metrics << "  \"producers\": [";
+    for(size_t q = 0; q < producers.size(); q++) metrics << (q > 0 ? ", " : "") << json_string(producers[q]->name());
+    metrics << "],\n";
+    metrics << "  \"input\": " << json_string(task.input) << ",\n";
+    metrics << "  \"sample\": " << json_string(boost::filesystem::path(task.input).stem().string()) << ",\n";
+    metrics << "  \"folder\": " << json_string(task.folder) << ",\n";
+    metrics << "  \"channel\": " << json_string(task.folder.substr(0, task.folder.find('_'))) << ",\n";
+    metrics << "  \"first_entry\": " << task.first_entry << ",\n";
+    metrics << "  \"last_entry\": " << task.last_entry << ",\n";
+    metrics << "  \"events\": " << events << ",\n";
+    metrics << "  \"events_per_second\": " << (total > 0.0 ? events / total : 0.0) << ",\n";
+    metrics << "  \"init_seconds\": " << json_object(init_times()) << ",\n";
+    metrics << "  \"stage_seconds\": " << json_object(stages) << ",\n";
+    metrics << "  \"read_calls\": " << read_calls << ",\n";
+    metrics << "  \"bytes_read\": " << bytes_read << ",\n";
+    metrics << "  \"peak_rss_kb\": " << peak_rss_kb() << "\n";
+    metrics << "}\n";
+}
+
+// Runs the given producers on a single read of the entry range of the task.
+// The friend tree of each producer is written to the corresponding output file, together with a json file
+// with the time spent in each stage of the event loop, the reads from the input files and the peak memory of the job.
+// With the pipeline enabled, the blocks are read, computed and filled on separate threads, see run_pipeline().
+// Input files given by input_files stay open for further tasks. The entry range is limited to the entries of the input tree.
+inline void run_producers(const std::vector<FriendProducer*>& producers, const std::vector<std::string>& outputnames, const ProducerTask& requested_task, unsigned int block_size = 1000, const WriterSettings& writer_settings = WriterSettings(),
+                          const ReaderSettings& reader_settings = ReaderSettings(), const PipelineSettings& pipeline_settings = PipelineSettings(), InputFiles* input_files = nullptr)
+{
+    InputFiles task_files;
+    InputFiles& files = input_files ? *input_files : task_files;
+    ProducerTask task = requested_task;
+    const auto start = std::chrono::steady_clock::now();
+    StageTimes stages;
+    std::vector<double> compute_seconds(producers.size(), 0.0);
+
+    // Access input file and tree
+    auto stage_start = std::chrono::steady_clock::now();
+    TaskTrees trees;
+    TFile* in = files.open(task.input);
+    TDirectoryFile* dir = (TDirectoryFile*) in->Get(task.folder.c_str());
+    if(!dir) throw std::runtime_error("Folder " + task.folder + " not found in " + task.input + ".");
+    TTree* inputtree = (TTree*) dir->Get(task.tree.c_str());
+    if(!inputtree) throw std::runtime_error("Tree " + task.folder + "/" + task.tree + " not found in " + task.input + ".");
+    trees.input = inputtree;
+    task.last_entry = std::min(task.last_entry, inputtree->GetEntries() - 1);
+    for(const auto& input_friend : task.input_friends)
+    {
+        TTree* friendtree = (TTree*) files.open(input_friend)->Get((task.folder + "/" + task.tree).c_str());
+        if(!friendtree) throw std::runtime_error("Tree " + task.folder + "/" + task.tree + " not found in " + input_friend + ".");
+        trees.friends.push_back(friendtree);
+        inputtree->AddFriend(friendtree);
+    }
+    stages["open"] = seconds_since(stage_start);
+
+    // Collect inputs and outputs of all producers
+    stage_start = std::chrono::steady_clock::now();
+    InputSchema input_schema(inputtree);
+    std::vector<OutputSchema> output_schemas(producers.size());
+    for(size_t p = 0; p < producers.size(); p++)
+    {
+        input_schema.set_producer(p);
+        producers[p]->declare(task, input_schema, output_schemas[p]);
+    }
+
+    // Event numbers of the rows of sparse outputs
+    EventNumberColumns event_numbers;
+    if(writer_settings.sparse)
+    {
+        event_numbers.run = input_schema.add<UInt_t>("run");
+        event_numbers.lumi = input_schema.add<UInt_t>("lumi");
+        event_numbers.event = input_schema.add<ULong64_t>("event");
+    }
+    ColumnReader reader(inputtree, input_schema);
+    reader.configure_cache(reader_settings, task.first_entry, task.last_entry);
+
+    // Initialize output files
+    std::vector<std::string> titles;
+    std::vector<std::map<std::string, std::string>> metadata;
+    for(const auto& producer : producers)
+    {
+        titles.push_back(producer->title());
+        metadata.push_back(producer->metadata());
+    }
+    // The pipeline fills the outputs on its own writer stage
+    WriterSettings output_settings = writer_settings;
+    if(pipeline_settings.enabled) output_settings.writer_queue = 0;
+    FriendTreeOutputs writer(outputnames, task.folder, titles, output_schemas, output_settings, metadata);
+    stages["declare"] = seconds_since(stage_start);
+
+    // Loop over desired events of the input tree in blocks & compute outputs
+    size_t events = 0;
+    const EventNumberColumns* sparse_event_numbers = writer_settings.sparse ? &event_numbers : nullptr;
+    if(pipeline_settings.enabled)
+    {
+        events = run_pipeline(producers, output_schemas, reader, writer, task, block_size, pipeline_settings, sparse_event_numbers, stages, compute_seconds);
+    }
+    else
+    {
+        InputBlock inputs;
+        std::vector<std::vector<bool>> selections(producers.size());
+        std::vector<OutputBlock> outputs(producers.size());
+        for(Long64_t block_first = task.first_entry; block_first <= task.last_entry; block_first += block_size)
+        {
+            const size_t size = std::min<Long64_t>(block_size, task.last_entry - block_first + 1);
+            read_block(reader, producers, block_first, size, inputs, selections, stages["read"], stages["select"]);
+            for(size_t p = 0; p < producers.size(); p++)
+            {
+                ScopedTimer timer(compute_seconds[p]);
+                compute_block(*producers[p], output_schemas[p], inputs, selections[p], sparse_event_numbers, outputs[p]);
+            }
+            {
+                // Time waiting for the writer thread, in case the queue is full. Without writer thread, this is the time to fill the outputs.
+                ScopedTimer timer(stages["writer_wait"]);
+                writer.write(outputs);
+            }
+            events += size;
+        }
+    }
+
+    // Fill output files
+    {
+        ScopedTimer timer(stages["finish"]);
+        for(auto producer : producers) producer->finish();
+    }
+    std::cout << task.folder << ": " << reader.summary() << std::endl;
+    writer.close();
+    stages["total"] = seconds_since(start);
+
+    // Metrics of each output, with the compute, fill and write times of its producer
+    for(size_t p = 0; p < producers.size(); p++)
+    {
+        StageTimes producer_stages = stages;
+        producer_stages["compute"] = compute_seconds[p];
+        producer_stages["fill"] = writer.writer(p).fill_seconds();
+        producer_stages["write"] = writer.writer(p).write_seconds();
+        write_metrics(outputnames[p], producers, p, task, events, producer_stages, reader.read_calls(), reader.bytes_read());
+    }
+}
+
+#endif
@@ -0,0 +1,283 @@
+#ifndef FRIEND_TREE_PRODUCER_FRIENDTREEWRITER_H
+#define FRIEND_TREE_PRODUCER_FRIENDTREEWRITER_H
+
+#include "RVersion.h"
+#include "TFile.h"
+#include "TList.h"
+#include "TNamed.h"
+#include "TROOT.h"
+#include "TTree.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "HiggsAnalysis/friend-tree-producer/interface/FriendProducer.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/JobMetrics.h"
+
+// Output settings shared by all friend tree executables. The defaults correspond to the ROOT defaults.
+struct WriterSettings
+{
+    std::string compression = "ZLIB";
+    int compression_level = 1;
+    int basket_size = 32000;
+    Long64_t auto_flush = -30000000;
+    // Number of blocks buffered for the writer thread. With 0, the outputs are filled on the compute thread.
+    unsigned int writer_queue = 4;
+    // Write only the entries selected by the producer, together with their entry number, run, lumi and event
+    bool sparse = false;
+};
+
+inline void add_writer_options(boost::program_options::options_description& config, WriterSettings& settings)
+{
+    namespace po = boost::program_options;
+    config.add_options()
+        ("compression", po::value<std::string>(&settings.compression)->default_value(settings.compression), "compression algorithm of the output: ZLIB, LZMA, LZ4 or ZSTD")
+        ("compression_level", po::value<int>(&settings.compression_level)->default_value(settings.compression_level))
+        ("basket_size", po::value<int>(&settings.basket_size)->default_value(settings.basket_size))
+        ("auto_flush", po::value<Long64_t>(&settings.auto_flush)->default_value(settings.auto_flush), "entries (> 0) or bytes (< 0) after which the baskets are written")
+        ("writer_queue", po::value<unsigned int>(&settings.writer_queue)->default_value(settings.writer_queue))
+        ("sparse_output", po::bool_switch(&settings.sparse), "write only the computed entries with an index, to be read with SparseFriendReader");
+}
+
+// Compression settings in the ROOT convention 100 * algorithm + level
+inline int compression_settings(const WriterSettings& settings)
+{
+    int algorithm = 0;
+    if(settings.compression == "ZLIB") algorithm = 1;
+    else if(settings.compression == "LZMA") algorithm = 2;
+    else if(settings.compression == "LZ4") algorithm = 4;
+    else if(settings.compression == "ZSTD")
+    {
+#if ROOT_VERSION_CODE < ROOT_VERSION(6, 20, 0)
+        throw std::runtime_error("ZSTD compression requires ROOT 6.20 or newer.");
+#endif
+        algorithm = 5;
+    }
+    else throw std::runtime_error("Unknown compression algorithm " + settings.compression + ".");
+    if(settings.compression_level < 0 || settings.compression_level > 9) throw std::runtime_error("Compression level has to be between 0 and 9.");
+    return 100 * algorithm + settings.compression_level;
+}
+
+// Output file with the friend tree of a single producer.
+//
+// In the sparse mode, only the entries selected by the producer are written, e.g. the events with at least two jets for MELA.
+// Each row has the additional branches entry, the entry number in the input tree, and run, lumi and event. The tree is
+// indexed by run and event, and SparseFriendReader gives the values of the input entries with default values for missing rows.
+class FriendTreeWriter
+{
+  public:
+    FriendTreeWriter(const std::string& outputname, const std::string& folder, const std::string& title, const OutputSchema& schema, const WriterSettings& settings = WriterSettings(),
+                     const std::map<std::string, std::string>& metadata = {})
+        : outputname_(outputname), folder_(folder), values_(schema.branches().size(), 0.0), sparse_(settings.sparse), entries_(0), fill_seconds_(0.0), write_seconds_(0.0)
+    {
+        boost::filesystem::path outputpath(outputname);
+        if(outputpath.has_parent_path()) boost::filesystem::create_directories(outputpath.parent_path());
+        file_ = TFile::Open(outputname.c_str(), "recreate");
+        if(!file_ || file_->IsZombie())
+        {
+            delete file_;
+            throw std::runtime_error("Could not create output file " + outputname + ".");
+        }
+        file_->SetCompressionSettings(compression_settings(settings));
+        file_->mkdir(folder.c_str());
+        file_->cd(folder.c_str());
+        tree_ = new TTree("ntuple", title.c_str());
+        tree_->SetAutoFlush(settings.auto_flush);
+        for(const auto& entry : metadata) tree_->GetUserInfo()->Add(new TNamed(entry.first.c_str(), entry.second.c_str()));
+        for(size_t index = 0; index < values_.size(); index++)
+        {
+            const std::string& branch = schema.branches()[index];
+            tree_->Branch(branch.c_str(), &values_[index], (branch + "/F").c_str(), settings.basket_size);
+        }
+        if(sparse_)
+        {
+            tree_->Branch("entry", &entry_, "entry/L", settings.basket_size);
+            tree_->Branch("run", &run_, "run/i", settings.basket_size);
+            tree_->Branch("lumi", &lumi_, "lumi/i", settings.basket_size);
+            tree_->Branch("event", &event_, "event/l", settings.basket_size);
+        }
+    }
+
+    void fill(const OutputBlock& block)
+    {
+        ScopedTimer timer(fill_seconds_);
+        const SparseRows& rows = block.sparse_rows();
+        entries_ += block.size();
+        for(size_t k = 0; k < block.size(); k++)
+        {
+            if(sparse_)
+            {
+                if(!rows.selected[k]) continue;
+                entry_ = rows.first_entry + k;
+                run_ = rows.run[k];
+                lumi_ = rows.lumi[k];
+                event_ = rows.event[k];
+            }
+            for(size_t index = 0; index < values_.size(); index++) values_[index] = block.value(index, k);
+            tree_->Fill();
+        }
+    }
+
+    void close()
+    {
+        ScopedTimer timer(write_seconds_);
+        file_->cd(folder_.c_str());
+        if(sparse_)
+        {
+            std::cout << outputname_ << ": sparse output with " << tree_->GetEntries() << " of " << entries_ << " entries" << std::endl;
+            if(tree_->GetEntries() > 0) tree_->BuildIndex("run", "event");
+        }
+        tree_->Write("", TObject::kOverwrite);
+        const Long64_t uncompressed_bytes = tree_->GetTotBytes();
+        const Long64_t compressed_bytes = tree_->GetZipBytes();
+        file_->Close();
+        std::cout << outputname_ << ": " << file_->GetBytesWritten() << " bytes written, tree baskets with "
+                  << compressed_bytes << " bytes compressed from " << uncompressed_bytes << " bytes" << std::endl;
+        delete file_;
+    }
+
+    // Time spent in filling the tree, including the compression of full baskets, and in writing the remaining baskets on close()
+    double fill_seconds() const { return fill_seconds_; }
+    double write_seconds() const { return write_seconds_; }
+
+  private:
+    std::string outputname_;
+    std::string folder_;
+    std::vector<Float_t> values_;
+    bool sparse_;
+    Long64_t entries_;
+    Long64_t entry_;
+    UInt_t run_, lumi_;
+    ULong64_t event_;
+    double fill_seconds_;
+    double write_seconds_;
+    TFile* file_;
+    TTree* tree_;
+};
+
+// Output files of all producers of a job. The outputs of each block are handed over through a bounded queue
+// to a writer thread, which fills and compresses the baskets while the next blocks are computed.
+// An exception on the writer thread stops it and is rethrown by the next write() or by close().
+class FriendTreeOutputs
+{
+  public:
+    FriendTreeOutputs(const std::vector<std::string>& outputnames, const std::string& folder, const std::vector<std::string>& titles, const std::vector<OutputSchema>& schemas, const WriterSettings& settings,
+                      const std::vector<std::map<std::string, std::string>>& metadata = {})
+        : queue_size_(settings.writer_queue), closed_(false)
+    {
+        for(size_t p = 0; p < outputnames.size(); p++)
+        {
+            writers_.emplace_back(new FriendTreeWriter(outputnames[p], folder, titles.at(p), schemas.at(p), settings, p < metadata.size() ? metadata[p] : std::map<std::string, std::string>()));
+        }
+        if(queue_size_ > 0)
+        {
+            // Input and output files are accessed from different threads
+            ROOT::EnableThreadSafety();
+            thread_ = std::thread(&FriendTreeOutputs::run, this);
+        }
+    }
+
+    ~FriendTreeOutputs()
+    {
+        if(thread_.joinable())
+        {
+            // Stop the writer thread, e.g. after an exception on the compute thread
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                closed_ = true;
+            }
+            changed_.notify_all();
+            thread_.join();
+        }
+    }
+
+    // Takes over the outputs of one block, with one OutputBlock per producer
+    void write(std::vector<OutputBlock>& blocks)
+    {
+        if(queue_size_ == 0)
+        {
+            for(size_t p = 0; p < writers_.size(); p++) writers_[p]->fill(blocks[p]);
+            return;
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        changed_.wait(lock, [this]() { return queue_.size() < queue_size_ || error_; });
+        if(error_) std::rethrow_exception(error_);
+        queue_.emplace_back(std::move(blocks));
+        blocks.clear();
+        blocks.resize(writers_.size());
+        lock.unlock();
+        changed_.notify_all();
+    }
+
+    // Writes the remaining outputs and closes the files
+    void close()
+    {
+        if(thread_.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                closed_ = true;
+            }
+            changed_.notify_all();
+            thread_.join();
+        }
+        if(error_) std::rethrow_exception(error_);
+        for(auto& writer : writers_) writer->close();
+    }
+
+    // Writer of the output of a single producer. Its timers are only accessed after close().
+    const FriendTreeWriter& writer(size_t p) const { return *writers_[p]; }
+
+  private:
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while(true)
+        {
+            changed_.wait(lock, [this]() { return queue_.size() > 0 || closed_; });
+            if(queue_.size() == 0) return;
+            std::vector<OutputBlock> blocks = std::move(queue_.front());
+            queue_.pop_front();
+            lock.unlock();
+            changed_.notify_all();
+            try
+            {
+                for(size_t p = 0; p < writers_.size(); p++) writers_[p]->fill(blocks[p]);
+            }
+            catch(...)
+            {
+                lock.lock();
+                error_ = std::current_exception();
+                queue_.clear();
+                lock.unlock();
+                changed_.notify_all();
+                return;
+            }
+            lock.lock();
+        }
+    }
+
+    std::vector<std::unique_ptr<FriendTreeWriter>> writers_;
+    size_t queue_size_;
+    std::deque<std::vector<OutputBlock>> queue_;
+    bool closed_;
+    // First exception of the writer thread
+    std::exception_ptr error_;
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::thread thread_;
+};
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef FRIEND_TREE_PRODUCER_GENERATEDNETWORK_H
+#define FRIEND_TREE_PRODUCER_GENERATEDNETWORK_H
+
+#include <stdexcept>
+#include <string>
+
+#include "HiggsAnalysis/friend-tree-producer/interface/NetworkKernels.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/NeuralNetwork.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/generated/GeneratedNetworks.h"
+
+// Network evaluated by a generated kernel, event by event on the columns of the inputs
+class GeneratedNetwork : public NeuralNetwork
+{
+  public:
+    explicit GeneratedNetwork(const std::string& name)
+    {
+        auto kernel = generated_kernels().find(name);
+        if(kernel == generated_kernels().end())
+        {
+            throw std::runtime_error("No generated kernel " + name + " available. Please generate it with generate_network_kernels.py and recompile.");
+        }
+        compute_ = kernel->second.compute;
+        input_names_ = kernel->second.input_names;
+        output_labels_ = kernel->second.output_labels;
+    }
+
+    void compute(const Eigen::MatrixXd& inputs, Eigen::MatrixXd& outputs) const override
+    {
+        if(static_cast<size_t>(inputs.rows()) != n_inputs()) throw std::runtime_error("Wrong number of inputs given to GeneratedNetwork.");
+        outputs.resize(n_outputs(), inputs.cols());
+        for(Eigen::Index k = 0; k < inputs.cols(); k++) compute_(inputs.col(k).data(), outputs.col(k).data());
+    }
+
+  private:
+    void (*compute_)(const double*, double*);
+};
+
+#endif
@@ -1,3 +1,6 @@
+#ifndef FRIEND_TREE_PRODUCER_HELPERFUNCTIONS_H
+#define FRIEND_TREE_PRODUCER_HELPERFUNCTIONS_H
+
 #include <boost/algorithm/string.hpp>
 #include <boost/regex.hpp>
 #include <boost/filesystem.hpp>
@@ -29,3 +32,5 @@ std::string outputname_from_settings(std::string input, std::string folder, unsi
 }
 
 const auto default_float = -10.f;
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef FRIEND_TREE_PRODUCER_JOBMETRICS_H
+#define FRIEND_TREE_PRODUCER_JOBMETRICS_H
+
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sys/resource.h>
+
+// Peak resident set size of the process in kB
+inline long peak_rss_kb()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// Seconds since the given start time
+inline double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Adds the time between construction and destruction to the given counter of seconds
+class ScopedTimer
+{
+  public:
+    explicit ScopedTimer(double& seconds) : seconds_(seconds), start_(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() { seconds_ += seconds_since(start_); }
+
+  private:
+    double& seconds_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// Named durations in seconds, kept in the order of their first use.
+// References to the durations stay valid when further stages are added.
+class StageTimes
+{
+  public:
+    double& operator[](const std::string& stage)
+    {
+        for(auto& entry : stages_)
+        {
+            if(entry.first == stage) return entry.second;
+        }
+        stages_.emplace_back(stage, 0.0);
+        return stages_.back().second;
+    }
+
+    const std::deque<std::pair<std::string, double>>& stages() const { return stages_; }
+
+  private:
+    std::deque<std::pair<std::string, double>> stages_;
+};
+
+// Initialization times of the job, e.g. construction of the producers and parsing of their models,
+// which are recorded once per process and included in the metrics of all outputs
+inline StageTimes& init_times()
+{
+    static StageTimes times;
+    return times;
+}
+
+inline std::string json_string(const std::string& value)
+{
+    std::string escaped = "\"";
+    for(char c : value)
+    {
+        if(c == '"' || c == '\\') escaped += '\\';
+        escaped += c;
+    }
+    return escaped + "\"";
+}
+
+inline std::string json_object(const StageTimes& times)
+{
+    std::stringstream object;
+    object << std::setprecision(6) << "{";
+    for(size_t s = 0; s < times.stages().size(); s++)
+    {
+        object << (s > 0 ? ", " : "") << json_string(times.stages()[s].first) << ": " << times.stages()[s].second;
+    }
+    object << "}";
+    return object.str();
+}
+
+// Path of the metrics file next to an output file <input>_<folder>_<first_entry>_<last_entry>.root
+inline std::string metrics_path(const std::string& outputname)
+{
+    const std::string extension = ".root";
+    if(outputname.size() > extension.size() && outputname.compare(outputname.size() - extension.size(), extension.size(), extension) == 0)
+    {
+        return outputname.substr(0, outputname.size() - extension.size()) + ".metrics.json";
+    }
+    return outputname + ".metrics.json";
+}
+
+#endif
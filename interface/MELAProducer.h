@@ -0,0 +1,319 @@
+#ifndef FRIEND_TREE_PRODUCER_MELAPRODUCER_H
+#define FRIEND_TREE_PRODUCER_MELAPRODUCER_H
+
+#include "ZZMatrixElement/MELA/interface/Mela.h"
+#include "ZZMatrixElement/MELA/interface/TUtil.hh"
+
+#include "TLorentzVector.h"
+
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+
+#include "HiggsAnalysis/friend-tree-producer/interface/FriendProducer.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/HelperFunctions.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/Preselection.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/ProcessPool.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/ResultCache.h"
+
+// Inputs of the MELA computation for a single event
+struct MELAInputs
+{
+    Float_t pt_1, eta_1, phi_1, m_1, q_1;
+    Float_t pt_2, eta_2, phi_2, m_2, q_2;
+    Float_t jpt_1, jeta_1, jphi_1;
+    Float_t jpt_2, jeta_2, jphi_2;
+};
+
+// Outputs of the MELA computation for a single event
+struct MELAResults
+{
+    float ME_vbf, ME_ggh, ME_z2j_1, ME_z2j_2;
+    float ME_q2v1, ME_q2v2;
+    float ME_costheta1, ME_costheta2, ME_phi, ME_costhetastar, ME_phi1;
+    float ME_vbf_vs_Z, ME_ggh_vs_Z, ME_vbf_vs_ggh;
+};
+
+// Matrix element discriminators and VBF angles of events with at least two jets, which pass the optional preselection
+class MELAProducer : public FriendProducer
+{
+  public:
+    // With workers > 0, the events are computed by forked worker processes, which inherit the initialized MELA instance.
+    // The producer has then to be created before any other threads are started.
+    explicit MELAProducer(const std::string& cache_dir = "", unsigned int workers = 0, const std::string& preselection = "")
+        : mela_(erg_tev, mPOLE, TVar::SILENT), preselection_(preselection), cache_dir_(cache_dir)
+    {
+
+        if(workers > 0)
+        {
+            pool_.reset(new ProcessPool<MELAInputs, MELAResults>(workers, worker_chunk_size,
+                                                                 [this](const MELAInputs& in, MELAResults& out) { compute_event(in, out); }));
+        }
+    }
+
+    std::string name() const override { return "MELA"; }
+    std::string title() const override { return "MELA friend tree"; }
+
+    std::map<std::string, std::string> metadata() const override
+    {
+        if(!preselection_.enabled()) return {};
+        return {{"preselection", preselection_.expression()}};
+    }
+
+    void declare(const ProducerTask& task, InputSchema& inputs, OutputSchema& outputs) override
+    {
+        // Set up persistent results from previous jobs on the sample of the input file, in case a cache directory is given
+        const std::string sample = cache_sample(task.input);
+        if(!cache_ || sample != cache_sample_)
+        {
+            std::stringstream cache_configuration;
+            cache_configuration << "MELA;erg_tev=" << erg_tev << ";mPOLE=" << mPOLE
+                                << ";hypotheses=JHUGen:HSMHiggs:JJVBF,JHUGen:SelfDefine_spin0(ghg2=1):JJQCD,MCFM:bkgZJets:JJQCD(both jet orderings)";
+            cache_.reset(new ResultCache<MELAInputs, MELAResults>(cache_dir_, "MELA", sample, cache_configuration.str()));
+            cache_sample_ = sample;
+        }
+
+        // Number of jets and branches of the preselection, read first to select the events
+        njets_ = inputs.add<Int_t>("njets");
+        preselection_.declare(inputs);
+
+        // Quantities of the leptons, followed by the quantities of the jets, in the order of MELAInputs,
+        // read only for the selected events
+        inputs_.clear();
+        for(const auto& quantity : {"pt_1", "eta_1", "phi_1", "m_1", "q_1", "pt_2", "eta_2", "phi_2", "m_2", "q_2",
+                                    "jpt_1", "jeta_1", "jphi_1", "jpt_2", "jeta_2", "jphi_2"})
+        {
+            inputs_.push_back(inputs.add_selected<Float_t>(quantity));
+        }
+
+        // MELA outputs
+        // 1. Matrix element variables for different hypotheses (VBF Higgs, ggH + 2 jets, Z + 2 jets)
+        ME_ggh_ = outputs.add("ME_ggh");
+        ME_vbf_ = outputs.add("ME_vbf");
+        ME_z2j_1_ = outputs.add("ME_z2j_1");
+        ME_z2j_2_ = outputs.add("ME_z2j_2");
+
+        // 2. Energy transfer (Q^2) variables
+        ME_q2v1_ = outputs.add("ME_q2v1");
+        ME_q2v2_ = outputs.add("ME_q2v2");
+
+        // 3. Angle variables
+        ME_costheta1_ = outputs.add("ME_costheta1");
+        ME_costheta2_ = outputs.add("ME_costheta2");
+        ME_phi_ = outputs.add("ME_phi");
+        ME_costhetastar_ = outputs.add("ME_costhetastar");
+        ME_phi1_ = outputs.add("ME_phi1");
+
+        // 4. Main BG vs. Higgs discriminators
+        ME_vbf_vs_Z_ = outputs.add("ME_vbf_vs_Z");
+        ME_ggh_vs_Z_ = outputs.add("ME_ggh_vs_Z");
+        ME_vbf_vs_ggh_ = outputs.add("ME_vbf_vs_ggh");
+    }
+
+    void select(const InputBlock& inputs, std::vector<bool>& selected) const override
+    {
+        const std::vector<Int_t>& njets = inputs.get(njets_);
+        for(size_t k = 0; k < inputs.size(); k++) selected[k] = njets[k] >= 2;
+        preselection_.evaluate(inputs, selected);
+    }
+
+    void compute(const InputBlock& inputs, const std::vector<bool>& selected, OutputBlock& outputs) override
+    {
+        std::vector<const std::vector<Float_t>*> columns;
+        for(const auto& column : inputs_) columns.push_back(&inputs.get(column));
+        // The preselection is counted for the events with two jets
+        const std::vector<Int_t>& njets = inputs.get(njets_);
+        for(size_t k = 0; k < inputs.size(); k++)
+        {
+            if(njets[k] >= 2) preselection_.count(selected[k]);
+        }
+
+        // Collect the events to be computed, filling defaults for events without two jets or failing the preselection
+        // and results from the cache, if available
+        pending_.clear();
+        pending_inputs_.clear();
+        MELAInputs event_inputs;
+        MELAResults event_results;
+        for(size_t k = 0; k < inputs.size(); k++)
+        {
+            if(!selected[k])
+            {
+                event_results = {default_float, default_float, default_float, default_float,
+                                 default_float, default_float,
+                                 default_float, default_float, default_float, default_float, default_float,
+                                 default_float, default_float, default_float};
+                set_results(outputs, k, event_results);
+                continue;
+            }
+            Float_t* values = &event_inputs.pt_1;
+            for(size_t index = 0; index < columns.size(); index++) values[index] = (*columns[index])[k];
+            if(cache_->get(event_inputs, event_results))
+            {
+                set_results(outputs, k, event_results);
+                continue;
+            }
+            pending_.push_back(k);
+            pending_inputs_.push_back(event_inputs);
+        }
+
+        // Run MELA on the remaining events, either in this process or on the workers
+        pending_results_.resize(pending_inputs_.size());
+        if(pool_)
+        {
+            pool_->run(pending_inputs_, pending_results_);
+        }
+        else
+        {
+            for(size_t i = 0; i < pending_inputs_.size(); i++) compute_event(pending_inputs_[i], pending_results_[i]);
+        }
+        for(size_t i = 0; i < pending_.size(); i++)
+        {
+            cache_->put(pending_inputs_[i], pending_results_[i]);
+            set_results(outputs, pending_[i], pending_results_[i]);
+        }
+    }
+
+    void finish() override
+    {
+        if(preselection_.enabled()) std::cout << preselection_.summary() << std::endl;
+        if(cache_ && cache_->enabled())
+        {
+            cache_->flush();
+            std::cout << cache_->summary() << std::endl;
+        }
+    }
+
+  private:
+    static constexpr int erg_tev = 13;
+    static constexpr float mPOLE = 125.6;
+    // Number of events handed over to a worker at once
+    static constexpr size_t worker_chunk_size = 16;
+
+    void compute_event(MELAInputs in, MELAResults& out)
+    {
+        // Sanitize charge for application on same-sign events
+        if(in.q_1 * in.q_2 > 0)
+        {
+            in.q_2 = -in.q_1;
+        }
+
+        // Build four-vectors
+        TLorentzVector tau1, tau2;
+        tau1.SetPtEtaPhiM(in.pt_1, in.eta_1, in.phi_1, in.m_1);
+        tau2.SetPtEtaPhiM(in.pt_2, in.eta_2, in.phi_2, in.m_2);
+
+        // FIXME: TODO: Why do we not use the jet mass here?
+        TLorentzVector jet1, jet2;
+        jet1.SetPtEtaPhiM(in.jpt_1, in.jeta_1, in.jphi_1, 0);
+        jet2.SetPtEtaPhiM(in.jpt_2, in.jeta_2, in.jphi_2, 0);
+
+        // Run MELA
+        SimpleParticleCollection_t daughters;
+        daughters.push_back(SimpleParticle_t(15 * in.q_1, tau1));
+        daughters.push_back(SimpleParticle_t(15 * in.q_2, tau2));
+
+        SimpleParticleCollection_t associated;
+        associated.push_back(SimpleParticle_t(0, jet1));
+        associated.push_back(SimpleParticle_t(0, jet2));
+
+        SimpleParticleCollection_t associated2;
+        associated2.push_back(SimpleParticle_t(0, jet2));
+        associated2.push_back(SimpleParticle_t(0, jet1));
+
+        mela_.resetInputEvent();
+        mela_.setCandidateDecayMode(TVar::CandidateDecay_ff);
+        mela_.setInputEvent(&daughters, &associated, (SimpleParticleCollection_t *)0, false);
+
+        // Hypothesis: SM VBF Higgs
+        mela_.setProcess(TVar::HSMHiggs, TVar::JHUGen, TVar::JJVBF);
+        mela_.computeProdP(out.ME_vbf, false);
+        mela_.computeVBFAngles(out.ME_q2v1, out.ME_q2v2, out.ME_costheta1, out.ME_costheta2, out.ME_phi, out.ME_costhetastar, out.ME_phi1);
+
+        // Hypothesis ggH + 2 jets
+        mela_.setProcess(TVar::SelfDefine_spin0, TVar::JHUGen, TVar::JJQCD);
+        mela_.selfDHggcoupl[0][gHIGGS_GG_2][0] = 1;
+        mela_.computeProdP(out.ME_ggh, false);
+
+        // Hypothesis: Z + 2 jets
+        // Compute the Hypothesis with flipped jets and sum them up for the discriminator.
+        mela_.setProcess(TVar::bkgZJets, TVar::MCFM, TVar::JJQCD);
+        mela_.computeProdP(out.ME_z2j_1, false);
+
+        mela_.resetInputEvent();
+        mela_.setInputEvent(&daughters, &associated2, (SimpleParticleCollection_t *)0, false);
+        mela_.computeProdP(out.ME_z2j_2, false);
+
+        // Compute discriminator for VBF vs Z
+        if((out.ME_vbf + out.ME_z2j_1 + out.ME_z2j_2) != 0.0)
+        {
+            out.ME_vbf_vs_Z = out.ME_vbf / (out.ME_vbf + out.ME_z2j_1 + out.ME_z2j_2);
+        }
+        else
+        {
+            std::cout << "WARNING: ME_vbf_vs_Z = X / 0. Setting it to default " << default_float << std::endl;
+            out.ME_vbf_vs_Z = default_float;
+        }
+
+        // Compute discriminator for ggH vs Z
+        if((out.ME_ggh + out.ME_z2j_1 + out.ME_z2j_2) != 0.0)
+        {
+            out.ME_ggh_vs_Z = out.ME_ggh / (out.ME_ggh + out.ME_z2j_1 + out.ME_z2j_2);
+        }
+        else
+        {
+            std::cout << "WARNING: ME_ggh_vs_Z = X / 0. Setting it to default " << default_float << std::endl;
+            out.ME_ggh_vs_Z = default_float;
+        }
+
+        // Compute discriminator for VBF vs ggH
+        if((out.ME_vbf + out.ME_ggh) != 0.0)
+        {
+            out.ME_vbf_vs_ggh = out.ME_vbf / (out.ME_vbf + out.ME_ggh);
+        }
+        else
+        {
+            std::cout << "WARNING: ME_vbf_vs_ggh = X / 0. Setting it to default " << default_float << std::endl;
+            out.ME_vbf_vs_ggh = default_float;
+        }
+    }
+
+    void set_results(OutputBlock& outputs, size_t k, const MELAResults& results) const
+    {
+        outputs.set(ME_vbf_, k, results.ME_vbf);
+        outputs.set(ME_ggh_, k, results.ME_ggh);
+        outputs.set(ME_z2j_1_, k, results.ME_z2j_1);
+        outputs.set(ME_z2j_2_, k, results.ME_z2j_2);
+        outputs.set(ME_q2v1_, k, results.ME_q2v1);
+        outputs.set(ME_q2v2_, k, results.ME_q2v2);
+        outputs.set(ME_costheta1_, k, results.ME_costheta1);
+        outputs.set(ME_costheta2_, k, results.ME_costheta2);
+        outputs.set(ME_phi_, k, results.ME_phi);
+        outputs.set(ME_costhetastar_, k, results.ME_costhetastar);
+        outputs.set(ME_phi1_, k, results.ME_phi1);
+        outputs.set(ME_vbf_vs_Z_, k, results.ME_vbf_vs_Z);
+        outputs.set(ME_ggh_vs_Z_, k, results.ME_ggh_vs_Z);
+        outputs.set(ME_vbf_vs_ggh_, k, results.ME_vbf_vs_ggh);
+    }
+
+    Mela mela_;
+    Preselection preselection_;
+    std::string cache_dir_;
+    std::string cache_sample_;
+    std::unique_ptr<ResultCache<MELAInputs, MELAResults>> cache_;
+    std::unique_ptr<ProcessPool<MELAInputs, MELAResults>> pool_;
+
+    // Events of the current block, which are not taken from the cache
+    std::vector<size_t> pending_;
+    std::vector<MELAInputs> pending_inputs_;
+    std::vector<MELAResults> pending_results_;
+
+    std::vector<InputColumn<Float_t>> inputs_;
+    InputColumn<Int_t> njets_;
+    OutputColumn ME_vbf_, ME_ggh_, ME_z2j_1_, ME_z2j_2_;
+    OutputColumn ME_q2v1_, ME_q2v2_;
+    OutputColumn ME_costheta1_, ME_costheta2_, ME_phi_, ME_costhetastar_, ME_phi1_;
+    OutputColumn ME_vbf_vs_Z_, ME_ggh_vs_Z_, ME_vbf_vs_ggh_;
+};
+
+#endif
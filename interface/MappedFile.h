@@ -0,0 +1,47 @@
+#ifndef FRIEND_TREE_PRODUCER_MAPPEDFILE_H
+#define FRIEND_TREE_PRODUCER_MAPPEDFILE_H
+
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Read-only memory mapping of a whole file. The pages are shared through the page cache
+// with all other processes mapping the same file.
+class MappedFile
+{
+  public:
+    explicit MappedFile(const std::string& path) : data_(nullptr), size_(0)
+    {
+        const int fd = open(path.c_str(), O_RDONLY);
+        if(fd < 0) throw std::runtime_error("Could not open " + path + ".");
+        struct stat status;
+        if(fstat(fd, &status) != 0 || status.st_size == 0)
+        {
+            close(fd);
+            throw std::runtime_error("Could not determine the size of " + path + ".");
+        }
+        size_ = status.st_size;
+        void* data = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if(data == MAP_FAILED) throw std::runtime_error("Could not map " + path + ".");
+        data_ = static_cast<const char*>(data);
+    }
+
+    ~MappedFile() { munmap(const_cast<char*>(data_), size_); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+  private:
+    const char* data_;
+    size_t size_;
+};
+
+#endif
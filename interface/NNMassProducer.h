@@ -0,0 +1,151 @@
+#ifndef FRIEND_TREE_PRODUCER_NNMASSPRODUCER_H
+#define FRIEND_TREE_PRODUCER_NNMASSPRODUCER_H
+
+#include "Math/LorentzVector.h"
+#include "Math/PtEtaPhiM4D.h"
+#include "Math/PxPyPzM4D.h"
+#include "Math/Vector4Dfwd.h"
+
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "HiggsAnalysis/friend-tree-producer/interface/FriendProducer.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/JobMetrics.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/NetworkSettings.h"
+
+// Di-tau system and tau four-vectors regressed by a neural network from the reconstructed taus and MET.
+// The network is evaluated for whole blocks of events.
+class NNMassProducer : public FriendProducer
+{
+  public:
+    explicit NNMassProducer(const std::string& lwtnn_config, const NetworkSettings& network_settings = NetworkSettings())
+    {
+        // Set up lwtnn, using the compiled network next to the config if available, or the generated kernel NNMass
+        if(!network_settings.generated_kernels && !boost::filesystem::exists(lwtnn_config) && !boost::filesystem::exists(compiled_network_path(lwtnn_config)))
+        {
+            throw std::runtime_error("LWTNN config file does not exist.");
+        }
+        {
+            ScopedTimer timer(init_times()["NNMass lwtnn"]);
+            model_ = load_network(lwtnn_config, "out_0", "NNMass", network_settings);
+        }
+
+        // Determine the position of each quantity within the network inputs and outputs
+        for(const auto& name : {"t1_rec_px", "t1_rec_py", "t1_rec_pz", "t1_rec_e", "t2_rec_px", "t2_rec_py", "t2_rec_pz", "t2_rec_e", "met_rec_px", "met_rec_py"})
+        {
+            auto position = std::find(model_->input_names().begin(), model_->input_names().end(), name);
+            if(position == model_->input_names().end()) throw std::runtime_error(std::string("Input ") + name + " not found in the NNMass model!");
+            input_rows_.push_back(position - model_->input_names().begin());
+        }
+        if(model_->n_inputs() != input_rows_.size()) throw std::runtime_error("Inputs of the NNMass model do not match the expected quantities!");
+        for(const auto& name : {"t1_gen_px", "t1_gen_py", "t1_gen_pz", "t2_gen_px", "t2_gen_py", "t2_gen_pz"})
+        {
+            auto position = std::find(model_->output_labels().begin(), model_->output_labels().end(), name);
+            if(position == model_->output_labels().end()) throw std::runtime_error(std::string("Output ") + name + " not found in the NNMass model!");
+            output_rows_.push_back(position - model_->output_labels().begin());
+        }
+    }
+
+    std::string name() const override { return "NNMass"; }
+    std::string title() const override { return "NN mass friend tree"; }
+
+    void declare(const ProducerTask& task, InputSchema& inputs, OutputSchema& outputs) override
+    {
+        // Quantities of first lepton
+        pt_1_ = inputs.add<Float_t>("pt_1");
+        eta_1_ = inputs.add<Float_t>("eta_1");
+        phi_1_ = inputs.add<Float_t>("phi_1");
+        m_1_ = inputs.add<Float_t>("m_1");
+
+        // Quantities of second lepton
+        pt_2_ = inputs.add<Float_t>("pt_2");
+        eta_2_ = inputs.add<Float_t>("eta_2");
+        phi_2_ = inputs.add<Float_t>("phi_2");
+        m_2_ = inputs.add<Float_t>("m_2");
+
+        // MET
+        met_ = inputs.add<Float_t>("met");
+        metphi_ = inputs.add<Float_t>("metphi");
+
+        // NN outputs
+        m_nn_ = outputs.add("m_nn");
+        pt_nn_ = outputs.add("pt_nn");
+        eta_nn_ = outputs.add("eta_nn");
+        phi_nn_ = outputs.add("phi_nn");
+        m_1_nn_ = outputs.add("m_1_nn");
+        pt_1_nn_ = outputs.add("pt_1_nn");
+        eta_1_nn_ = outputs.add("eta_1_nn");
+        phi_1_nn_ = outputs.add("phi_1_nn");
+        m_2_nn_ = outputs.add("m_2_nn");
+        pt_2_nn_ = outputs.add("pt_2_nn");
+        eta_2_nn_ = outputs.add("eta_2_nn");
+        phi_2_nn_ = outputs.add("phi_2_nn");
+    }
+
+    void compute(const InputBlock& inputs, const std::vector<bool>& selected, OutputBlock& outputs) override
+    {
+        typedef ROOT::Math::LorentzVector<ROOT::Math::PtEtaPhiM4D<double> > PtEtaPhiMVector;
+        typedef ROOT::Math::LorentzVector<ROOT::Math::PxPyPzM4D<double> > PxPyPzMVector;
+        const Eigen::Index n_events = inputs.size();
+
+        // Fill network inputs from the four-vectors of reco taus and reco met, one column per event
+        block_inputs_.resize(input_rows_.size(), n_events);
+        for(Eigen::Index k = 0; k < n_events; k++)
+        {
+            PtEtaPhiMVector rectau1(inputs.get(pt_1_)[k], inputs.get(eta_1_)[k], inputs.get(phi_1_)[k], inputs.get(m_1_)[k]);
+            PtEtaPhiMVector rectau2(inputs.get(pt_2_)[k], inputs.get(eta_2_)[k], inputs.get(phi_2_)[k], inputs.get(m_2_)[k]);
+            PtEtaPhiMVector recmet(inputs.get(met_)[k], 0.0, inputs.get(metphi_)[k], 0.0);
+            const double values[] = {rectau1.Px(), rectau1.Py(), rectau1.Pz(), rectau1.E(), rectau2.Px(), rectau2.Py(), rectau2.Pz(), rectau2.E(), recmet.Px(), recmet.Py()};
+            for(size_t n = 0; n < input_rows_.size(); n++) block_inputs_(input_rows_[n], k) = values[n];
+        }
+
+        // Run computation
+        model_->compute(block_inputs_, block_outputs_);
+
+        for(Eigen::Index k = 0; k < n_events; k++)
+        {
+            // Compute output taus four-vectors
+            const double tau_mass = 1.776;
+            PxPyPzMVector gentau1(block_outputs_(output_rows_[0], k), block_outputs_(output_rows_[1], k), block_outputs_(output_rows_[2], k), tau_mass);
+            PxPyPzMVector gentau2(block_outputs_(output_rows_[3], k), block_outputs_(output_rows_[4], k), block_outputs_(output_rows_[5], k), tau_mass);
+
+            // Compute Higgs four-vector
+            const auto higgs = gentau1 + gentau2;
+
+            // Set outputs
+            outputs.set(m_nn_, k, higgs.mass());
+            outputs.set(pt_nn_, k, higgs.pt());
+            outputs.set(eta_nn_, k, higgs.eta());
+            outputs.set(phi_nn_, k, higgs.phi());
+
+            outputs.set(m_1_nn_, k, gentau1.mass());
+            outputs.set(pt_1_nn_, k, gentau1.pt());
+            outputs.set(eta_1_nn_, k, gentau1.eta());
+            outputs.set(phi_1_nn_, k, gentau1.phi());
+
+            outputs.set(m_2_nn_, k, gentau2.mass());
+            outputs.set(pt_2_nn_, k, gentau2.pt());
+            outputs.set(eta_2_nn_, k, gentau2.eta());
+            outputs.set(phi_2_nn_, k, gentau2.phi());
+        }
+    }
+
+  private:
+    std::unique_ptr<NeuralNetwork> model_;
+    // Rows of the network inputs t1_rec_px, ..., met_rec_py and outputs t1_gen_px, ..., t2_gen_pz
+    std::vector<size_t> input_rows_;
+    std::vector<size_t> output_rows_;
+    Eigen::MatrixXd block_inputs_, block_outputs_;
+
+    InputColumn<Float_t> pt_1_, eta_1_, phi_1_, m_1_, pt_2_, eta_2_, phi_2_, m_2_, met_, metphi_;
+    OutputColumn m_nn_, pt_nn_, eta_nn_, phi_nn_;
+    OutputColumn m_1_nn_, pt_1_nn_, eta_1_nn_, phi_1_nn_;
+    OutputColumn m_2_nn_, pt_2_nn_, eta_2_nn_, phi_2_nn_;
+};
+
+#endif
@@ -0,0 +1,177 @@
+#ifndef FRIEND_TREE_PRODUCER_NNSCOREPRODUCER_H
+#define FRIEND_TREE_PRODUCER_NNSCOREPRODUCER_H
+
+#include <boost/algorithm/string.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+
+#include "HiggsAnalysis/friend-tree-producer/interface/FriendProducer.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/JobMetrics.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/HelperFunctions.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/NetworkSettings.h"
+
+// Scores of the event classification networks, trained per year and channel with two folds.
+// The model trained on fold0 is applied on odd events, the model trained on fold1 on even events.
+// With generated kernels, the models NNScore_<year>_<channel>_fold<fold> compiled into the executable are used.
+class NNScoreProducer : public FriendProducer
+{
+  public:
+    NNScoreProducer(const std::string& lwtnn_config, const std::string& datasets, const NetworkSettings& network_settings = NetworkSettings())
+        : lwtnn_config_(lwtnn_config), network_settings_(network_settings)
+    {
+        if(!network_settings.generated_kernels && !boost::filesystem::exists(lwtnn_config))
+        {
+            throw std::runtime_error("LWTNN config file does not exist.");
+        }
+
+        // Load datasets.json to determine year of the sample per nick
+        boost::property_tree::json_parser::read_json(datasets, datasets_json_);
+    }
+
+    std::string name() const override { return "NNScore"; }
+    std::string title() const override { return "NN score friend tree"; }
+
+    void declare(const ProducerTask& task, InputSchema& inputs, OutputSchema& outputs) override
+    {
+        std::string channel = folder_to_channel(task.folder);
+        std::vector<std::string> input_split;
+        boost::split(input_split, task.input, boost::is_any_of("/"));
+        std::string nick = input_split.end()[-2];
+        int year = datasets_json_.get_child(nick).get<int>("year");
+
+        // Set up lwtnn, once per year and channel
+        const std::string model_directory = lwtnn_config_ + "/" + std::to_string(year) + "/" + channel;
+        const std::string kernel_name = "NNScore_" + std::to_string(year) + "_" + channel + "_fold";
+        std::map<int, std::unique_ptr<NeuralNetwork>>& models = models_[model_directory];
+        if(models.size() == 0)
+        {
+            ScopedTimer timer(init_times()["NNScore lwtnn"]);
+            models[1] = load_network(model_directory + "/fold0_lwtnn.json", "total_softmax_0", kernel_name + "0", network_settings_);
+            std::cout << "Loading fold0 model for application on ODD events (event % 2 == 1)" << std::endl;
+
+            models[0] = load_network(model_directory + "/fold1_lwtnn.json", "total_softmax_0", kernel_name + "1", network_settings_);
+            std::cout << "Loading fold1 model for application on EVEN events (event % 2 == 0)" << std::endl;
+
+            if(models[0]->input_names() != models[1]->input_names() || models[0]->output_labels() != models[1]->output_labels())
+            {
+                throw std::runtime_error("Models of fold0 and fold1 differ in their inputs or outputs!");
+            }
+        }
+        models_by_fold_ = &models;
+        const std::vector<std::string>& input_names = models[1]->input_names();
+        const std::vector<std::string>& output_labels = models[1]->output_labels();
+
+        // Initialize inputs, each bound to a fixed position of the network input
+        float_inputs_.clear();
+        int_inputs_.clear();
+        for(size_t n = 0; n < input_names.size(); n++)
+        {
+            std::string input_type = inputs.type_name(input_names.at(n));
+            if(input_type == "Float_t")
+            {
+                float_inputs_.emplace_back(n, inputs.add<Float_t>(input_names.at(n)));
+            }
+            else if(input_type == "Int_t")
+            {
+                int_inputs_.emplace_back(n, inputs.add<Int_t>(input_names.at(n)));
+            }
+            else
+            {
+                throw std::runtime_error("Type " + input_type + " not implemented!");
+            }
+        }
+        event_ = inputs.add<ULong64_t>("event");
+
+        // Initialize outputs for the tree
+        outputs_.clear();
+        for(size_t n = 0; n < output_labels.size(); n++)
+        {
+            outputs_.push_back(outputs.add(channel + "_" + output_labels.at(n)));
+        }
+        max_score_ = outputs.add(channel + "_max_score");
+        max_index_ = outputs.add(channel + "_max_index");
+    }
+
+    // The inputs of a block are grouped by fold, such that each model is applied once per block on all of its events
+    void compute(const InputBlock& inputs, const std::vector<bool>& selected, OutputBlock& outputs) override
+    {
+        const Eigen::Index n_events = inputs.size();
+        const size_t n_inputs = float_inputs_.size() + int_inputs_.size();
+        const size_t n_outputs = outputs_.size();
+
+        // Arrange the inputs of the block, one column per event
+        block_inputs_.resize(n_inputs, n_events);
+        for(const auto& input : float_inputs_)
+        {
+            const std::vector<Float_t>& values = inputs.get(input.second);
+            for(Eigen::Index k = 0; k < n_events; k++) block_inputs_(input.first, k) = values[k];
+        }
+        for(const auto& input : int_inputs_)
+        {
+            const std::vector<Int_t>& values = inputs.get(input.second);
+            for(Eigen::Index k = 0; k < n_events; k++) block_inputs_(input.first, k) = values[k];
+        }
+        const std::vector<ULong64_t>& event = inputs.get(event_);
+
+        // Apply the models on the events of their fold
+        block_scores_.resize(n_outputs, n_events);
+        for(auto& model : *models_by_fold_)
+        {
+            fold_events_.clear();
+            for(Eigen::Index k = 0; k < n_events; k++)
+            {
+                if(static_cast<int>(event[k] % 2) == model.first) fold_events_.push_back(k);
+            }
+            if(fold_events_.size() == 0) continue;
+            fold_inputs_.resize(n_inputs, fold_events_.size());
+            for(size_t f = 0; f < fold_events_.size(); f++) fold_inputs_.col(f) = block_inputs_.col(fold_events_[f]);
+            model.second->compute(fold_inputs_, fold_outputs_);
+            for(size_t f = 0; f < fold_events_.size(); f++) block_scores_.col(fold_events_[f]) = fold_outputs_.col(f);
+        }
+
+        for(Eigen::Index k = 0; k < n_events; k++)
+        {
+            Float_t max_score = default_float;
+            Float_t max_index = 0.0;
+            for(size_t index = 0; index < n_outputs; index++)
+            {
+                auto output_value = block_scores_(index, k);
+                outputs.set(outputs_[index], k, output_value);
+                if(output_value > max_score)
+                {
+                    max_score = output_value;
+                    max_index = index;
+                }
+            }
+            outputs.set(max_score_, k, max_score);
+            outputs.set(max_index_, k, max_index);
+        }
+    }
+
+  private:
+    std::string lwtnn_config_;
+    boost::property_tree::ptree datasets_json_;
+    NetworkSettings network_settings_;
+    std::map<std::string, std::map<int, std::unique_ptr<NeuralNetwork>>> models_;
+    std::map<int, std::unique_ptr<NeuralNetwork>>* models_by_fold_ = nullptr;
+
+    // Position within the network inputs and input column
+    std::vector<std::pair<size_t, InputColumn<Float_t>>> float_inputs_;
+    std::vector<std::pair<size_t, InputColumn<Int_t>>> int_inputs_;
+    InputColumn<ULong64_t> event_;
+    std::vector<OutputColumn> outputs_;
+    OutputColumn max_score_, max_index_;
+
+    Eigen::MatrixXd block_inputs_, fold_inputs_, fold_outputs_, block_scores_;
+    std::vector<Eigen::Index> fold_events_;
+};
+
+#endif
@@ -0,0 +1,238 @@
+#ifndef FRIEND_TREE_PRODUCER_NNRECOILPRODUCER_H
+#define FRIEND_TREE_PRODUCER_NNRECOILPRODUCER_H
+
+#include <boost/filesystem.hpp>
+
+#include <cmath>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+
+#include "HiggsAnalysis/friend-tree-producer/interface/FriendProducer.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/JobMetrics.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/HelperFunctions.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/NetworkSettings.h"
+
+// Hadronic recoil regressed by a neural network from several MET definitions, and the quantities derived from it.
+// All quantities are computed for whole blocks of events on structure-of-arrays kernels.
+class NNrecoilProducer : public FriendProducer
+{
+  public:
+    explicit NNrecoilProducer(const std::string& lwtnn_config, const NetworkSettings& network_settings = NetworkSettings())
+        : met_definitions_({"", "track", "nopu", "pucor", "pu", "puppi"}), met_quantities_({"met", "metphi", "metsumet"})
+    {
+        // Set up lwtnn, or the generated kernel NNrecoil
+        if(!network_settings.generated_kernels && !boost::filesystem::exists(lwtnn_config))
+        {
+            throw std::runtime_error("LWTNN config file does not exist.");
+        }
+        {
+            ScopedTimer timer(init_times()["NNrecoil lwtnn"]);
+            model_ = load_network(lwtnn_config + "/NNrecoil/NNrecoil_lwtnn.json", "", "NNrecoil", network_settings);
+        }
+
+        // Determine the position of each quantity within the network inputs
+        const size_t n_met = met_definitions_.size();
+        recoil_x_row_.assign(n_met, -1);
+        recoil_y_row_.assign(n_met, -1);
+        sumet_row_.assign(n_met, -1);
+        for(size_t n = 0; n < model_->n_inputs(); n++)
+        {
+            const std::string& name = model_->input_names().at(n);
+            if(name == "npv") npv_row_ = n;
+            for(size_t metindex = 0; metindex < n_met; ++metindex)
+            {
+                if(name == met_definitions_.at(metindex) + "metpx") recoil_x_row_[metindex] = n;
+                else if(name == met_definitions_.at(metindex) + "metpy") recoil_y_row_[metindex] = n;
+                else if(name == met_definitions_.at(metindex) + met_quantities_.at(2)) sumet_row_[metindex] = n;
+            }
+        }
+        for(size_t metindex = 0; metindex < n_met; ++metindex)
+        {
+            if(recoil_x_row_[metindex] < 0 || recoil_y_row_[metindex] < 0 || sumet_row_[metindex] < 0 || npv_row_ < 0 || model_->n_inputs() != 3 * n_met + 1)
+            {
+                throw std::runtime_error("Inputs of the NNrecoil model do not match the expected MET definitions!");
+            }
+        }
+    }
+
+    std::string name() const override { return "NNrecoil"; }
+    std::string title() const override { return "NN score friend tree"; }
+
+    void declare(const ProducerTask& task, InputSchema& inputs, OutputSchema& outputs) override
+    {
+        // MET inputs, one row of quantities per MET definition
+        met_inputs_.clear();
+        for(const auto& met_definition : met_definitions_)
+        {
+            for(const auto& met_quantity : met_quantities_) met_inputs_.push_back(inputs.add<Float_t>(met_definition + met_quantity));
+        }
+
+        // NPV
+        npv_ = inputs.add<Int_t>("npv");
+
+        // Lepton inputs
+        njets_ = inputs.add<Int_t>("njets");
+        pt_1_ = inputs.add<Float_t>("pt_1");
+        pt_2_ = inputs.add<Float_t>("pt_2");
+        phi_1_ = inputs.add<Float_t>("phi_1");
+        phi_2_ = inputs.add<Float_t>("phi_2");
+        ptcharged_1_ = inputs.add<Float_t>("ptcharged_1");
+        ptcharged_2_ = inputs.add<Float_t>("ptcharged_2");
+        phicharged_1_ = inputs.add<Float_t>("phicharged_1");
+        phicharged_2_ = inputs.add<Float_t>("phicharged_2");
+
+        // Jet inputs
+        jpt_1_ = inputs.add<Float_t>("jpt_1");
+        jpt_2_ = inputs.add<Float_t>("jpt_2");
+        jphi_1_ = inputs.add<Float_t>("jphi_1");
+        jphi_2_ = inputs.add<Float_t>("jphi_2");
+
+        // Initialize outputs for the tree
+        outputs_.clear();
+        for(const auto& label : model_->output_labels()) outputs_.push_back(outputs.add(label));
+        NNrecoil_pt_ = outputs.add("NNrecoil_pt");
+        NNrecoil_phi_ = outputs.add("NNrecoil_phi");
+        nnmet_ = outputs.add("nnmet");
+        nnmetphi_ = outputs.add("nnmetphi");
+        mt_1_nn_ = outputs.add("mt_1_nn");
+        mt_2_nn_ = outputs.add("mt_2_nn");
+        mt_tot_nn_ = outputs.add("mt_tot_nn");
+        pt_tt_nn_ = outputs.add("pt_tt_nn");
+        pt_ttjj_nn_ = outputs.add("pt_ttjj_nn");
+        pZetaNNMissVis_ = outputs.add("pZetaNNMissVis");
+        mTdileptonMET_nn_ = outputs.add("mTdileptonMET_nn");
+    }
+
+    void compute(const InputBlock& inputs, const std::vector<bool>& selected, OutputBlock& outputs) override
+    {
+        const Eigen::Index n_events = inputs.size();
+        const size_t n_met = met_definitions_.size();
+        const size_t n_quantities = met_quantities_.size();
+
+        // Structure of arrays for the block of events, one entry per event
+        const Eigen::ArrayXd b_pt_1 = array(inputs.get(pt_1_)), b_pt_2 = array(inputs.get(pt_2_));
+        const Eigen::ArrayXd b_phi_1 = array(inputs.get(phi_1_)), b_phi_2 = array(inputs.get(phi_2_));
+        const Eigen::ArrayXd b_ptcharged_1 = array(inputs.get(ptcharged_1_)), b_ptcharged_2 = array(inputs.get(ptcharged_2_));
+        const Eigen::ArrayXd b_phicharged_1 = array(inputs.get(phicharged_1_)), b_phicharged_2 = array(inputs.get(phicharged_2_));
+        const Eigen::ArrayXd b_jpt_1 = array(inputs.get(jpt_1_)), b_jpt_2 = array(inputs.get(jpt_2_));
+        const Eigen::ArrayXd b_jphi_1 = array(inputs.get(jphi_1_)), b_jphi_2 = array(inputs.get(jphi_2_));
+        const Eigen::ArrayXd b_npv = array(inputs.get(npv_));
+        const std::vector<Int_t>& b_njets = inputs.get(njets_);
+
+        // Cartesian components of the leptons and jets
+        const Eigen::ArrayXd lep1_x = b_pt_1 * b_phi_1.cos(), lep1_y = b_pt_1 * b_phi_1.sin();
+        const Eigen::ArrayXd lep2_x = b_pt_2 * b_phi_2.cos(), lep2_y = b_pt_2 * b_phi_2.sin();
+        const Eigen::ArrayXd boson_x = lep1_x + lep2_x, boson_y = lep1_y + lep2_y;
+        const Eigen::ArrayXd lepcharged_x = b_ptcharged_1 * b_phicharged_1.cos() + b_ptcharged_2 * b_phicharged_2.cos();
+        const Eigen::ArrayXd lepcharged_y = b_ptcharged_1 * b_phicharged_1.sin() + b_ptcharged_2 * b_phicharged_2.sin();
+        const Eigen::ArrayXd dijet_x = b_jpt_1 * b_jphi_1.cos() + b_jpt_2 * b_jphi_2.cos();
+        const Eigen::ArrayXd dijet_y = b_jpt_1 * b_jphi_1.sin() + b_jpt_2 * b_jphi_2.sin();
+        const Eigen::ArrayXf lep_pt_sum = b_pt_1.cast<float>() + b_pt_2.cast<float>();
+        const Eigen::ArrayXf lepcharged_pt_sum = b_ptcharged_1.cast<float>() + b_ptcharged_2.cast<float>();
+
+        // Recoil (Recoil + Resonance = - MET) and sum E_T per MET definition as network inputs, one column per event
+        model_inputs_.resize(model_->n_inputs(), n_events);
+        for(size_t metindex = 0; metindex < n_met; ++metindex)
+        {
+            const Eigen::ArrayXd met = array(inputs.get(met_inputs_[metindex * n_quantities]));
+            const Eigen::ArrayXd metphi = array(inputs.get(met_inputs_[metindex * n_quantities + 1]));
+            Eigen::ArrayXd recoil_x = - met * metphi.cos();
+            Eigen::ArrayXd recoil_y = - met * metphi.sin();
+            Eigen::ArrayXf sumet = Eigen::Map<const Eigen::ArrayXf>(inputs.get(met_inputs_[metindex * n_quantities + 2]).data(), n_events);
+            // Subtract di-tau leptons in case of charged met definitions from PV
+            if(metindex != 4) // No substraction for PU met
+            {
+                if(metindex != 1) // Subtract only charged part in case of trackMet
+                {
+                    sumet -= lep_pt_sum;
+                    recoil_x -= boson_x; // subtracting Resonance = di-Tau pair
+                    recoil_y -= boson_y;
+                }
+                else
+                {
+                    sumet -= lepcharged_pt_sum;
+                    recoil_x -= lepcharged_x; // subtracting charged part of Resonance = di-Tau pair
+                    recoil_y -= lepcharged_y;
+                }
+            }
+            model_inputs_.row(recoil_x_row_[metindex]) = recoil_x.matrix().transpose();
+            model_inputs_.row(recoil_y_row_[metindex]) = recoil_y.matrix().transpose();
+            model_inputs_.row(sumet_row_[metindex]) = sumet.cast<double>().matrix().transpose();
+        }
+        model_inputs_.row(npv_row_) = b_npv.matrix().transpose();
+
+        // Apply model on inputs
+        model_->compute(model_inputs_, model_outputs_);
+
+        // Compute additional outputs for the whole block.
+        // Transverse masses use m_T^2 = 2 (|a||b| - a.b), avoiding angles and trigonometric functions.
+        const Eigen::ArrayXd nnrecoil_x = model_outputs_.row(0).transpose().array();
+        const Eigen::ArrayXd nnrecoil_y = model_outputs_.row(1).transpose().array();
+        const Eigen::ArrayXd nnrecoil_pt = (nnrecoil_x.square() + nnrecoil_y.square()).sqrt();
+        const Eigen::ArrayXd nnmet_x = - (nnrecoil_x + boson_x);
+        const Eigen::ArrayXd nnmet_y = - (nnrecoil_y + boson_y);
+        const Eigen::ArrayXd nnmet_pt = (nnmet_x.square() + nnmet_y.square()).sqrt();
+        const Eigen::ArrayXd boson_pt = (boson_x.square() + boson_y.square()).sqrt();
+        const Eigen::ArrayXd mt_1_squared = (2 * (b_pt_1 * nnmet_pt - (lep1_x * nnmet_x + lep1_y * nnmet_y))).max(0.0);
+        const Eigen::ArrayXd mt_2_squared = (2 * (b_pt_2 * nnmet_pt - (lep2_x * nnmet_x + lep2_y * nnmet_y))).max(0.0);
+        const Eigen::ArrayXd mt_lep_squared = (2 * (b_pt_1 * b_pt_2 - (lep1_x * lep2_x + lep1_y * lep2_y))).max(0.0);
+        const Eigen::ArrayXd mt_boson_squared = (2 * (boson_pt * nnmet_pt - (boson_x * nnmet_x + boson_y * nnmet_y))).max(0.0);
+        const Eigen::ArrayXd ptttjj = ((dijet_x - nnrecoil_x).square() + (dijet_y - nnrecoil_y).square()).sqrt();
+
+        // Bisector of the lepton directions
+        const Eigen::ArrayXd zeta_x_unnormalized = b_phi_1.cos() + b_phi_2.cos();
+        const Eigen::ArrayXd zeta_y_unnormalized = b_phi_1.sin() + b_phi_2.sin();
+        const Eigen::ArrayXd zeta_norm = (zeta_x_unnormalized.square() + zeta_y_unnormalized.square()).sqrt();
+        const Eigen::ArrayXd zeta_x = zeta_x_unnormalized / zeta_norm, zeta_y = zeta_y_unnormalized / zeta_norm;
+        const Eigen::ArrayXd pzeta_vis = boson_x * zeta_x + boson_y * zeta_y;
+        const Eigen::ArrayXd pzeta_miss = nnmet_x * zeta_x + nnmet_y * zeta_y;
+
+        for(Eigen::Index k = 0; k < n_events; k++)
+        {
+            // Network outputs
+            for(size_t index = 0; index < outputs_.size(); index++)
+            {
+                outputs.set(outputs_[index], k, model_outputs_(index, k));
+            }
+            // Additional outputs
+            outputs.set(NNrecoil_pt_, k, nnrecoil_pt(k));
+            outputs.set(NNrecoil_phi_, k, std::atan2(nnrecoil_y(k), nnrecoil_x(k)));
+            outputs.set(nnmet_, k, nnmet_pt(k));
+            outputs.set(nnmetphi_, k, std::atan2(nnmet_y(k), nnmet_x(k)));
+            outputs.set(mt_1_nn_, k, std::sqrt(mt_1_squared(k)));
+            outputs.set(mt_2_nn_, k, std::sqrt(mt_2_squared(k)));
+            outputs.set(mt_tot_nn_, k, std::sqrt(mt_1_squared(k) + mt_2_squared(k) + mt_lep_squared(k)));
+            outputs.set(pt_tt_nn_, k, nnrecoil_pt(k));
+            outputs.set(pt_ttjj_nn_, k, (b_njets[k] >= 2) ? ptttjj(k) : default_float);
+            outputs.set(pZetaNNMissVis_, k, pzeta_miss(k) - 0.85 * pzeta_vis(k));
+            outputs.set(mTdileptonMET_nn_, k, std::sqrt(mt_boson_squared(k)));
+        }
+    }
+
+  private:
+    template <typename T>
+    static Eigen::ArrayXd array(const std::vector<T>& values)
+    {
+        return Eigen::Map<const Eigen::Array<T, Eigen::Dynamic, 1>>(values.data(), values.size()).template cast<double>();
+    }
+
+    std::vector<std::string> met_definitions_;
+    std::vector<std::string> met_quantities_;
+    std::unique_ptr<NeuralNetwork> model_;
+    std::vector<int> recoil_x_row_, recoil_y_row_, sumet_row_;
+    int npv_row_ = -1;
+
+    std::vector<InputColumn<Float_t>> met_inputs_;
+    InputColumn<Int_t> npv_, njets_;
+    InputColumn<Float_t> pt_1_, pt_2_, phi_1_, phi_2_, ptcharged_1_, ptcharged_2_, phicharged_1_, phicharged_2_;
+    InputColumn<Float_t> jpt_1_, jpt_2_, jphi_1_, jphi_2_;
+
+    std::vector<OutputColumn> outputs_;
+    OutputColumn NNrecoil_pt_, NNrecoil_phi_, nnmet_, nnmetphi_;
+    OutputColumn mt_1_nn_, mt_2_nn_, mt_tot_nn_, pt_tt_nn_, pt_ttjj_nn_, pZetaNNMissVis_, mTdileptonMET_nn_;
+
+    Eigen::MatrixXd model_inputs_, model_outputs_;
+};
+
+#endif
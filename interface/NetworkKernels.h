@@ -0,0 +1,87 @@
+#ifndef FRIEND_TREE_PRODUCER_NETWORKKERNELS_H
+#define FRIEND_TREE_PRODUCER_NETWORKKERNELS_H
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <string>
+#include <vector>
+
+// Building blocks of the network kernels generated by scripts/generate_network_kernels.py.
+// The layer dimensions and activation functions are template parameters, such that the compiler
+// can unroll and vectorize the loops and fuse the activation with the dense layer.
+enum class KernelActivation { Linear, Sigmoid, Rectified, Tanh, HardSigmoid, ELU, LeakyReLU, Swish, Softmax };
+
+// Activation of a single value, with the conventions of the lwtnn layers and DenseNetwork
+template <KernelActivation Activation>
+inline double activate(double x, double alpha)
+{
+    if(Activation == KernelActivation::Sigmoid) return x < -30.0 ? 0.0 : (x > 30.0 ? 1.0 : 1.0 / (1.0 + std::exp(-x)));
+    if(Activation == KernelActivation::Rectified) return x > 0.0 ? x : 0.0;
+    if(Activation == KernelActivation::Tanh) return std::tanh(x);
+    if(Activation == KernelActivation::HardSigmoid) return std::min(1.0, std::max(0.0, 0.2 * x + 0.5));
+    if(Activation == KernelActivation::ELU) return x > 0.0 ? x : alpha * (std::exp(x) - 1.0);
+    if(Activation == KernelActivation::LeakyReLU) return x > 0.0 ? x : alpha * x;
+    if(Activation == KernelActivation::Swish) return x / (1.0 + std::exp(-alpha * x));
+    return x;
+}
+
+template <size_t N>
+inline void softmax(double* values)
+{
+    // lwtnn subtracts the maximum in single precision for numerical stability
+    const float max = *std::max_element(values, values + N);
+    double sum = 0.0;
+    for(size_t n = 0; n < N; n++)
+    {
+        values[n] = std::exp(values[n] - max);
+        sum += values[n];
+    }
+    for(size_t n = 0; n < N; n++) values[n] /= sum;
+}
+
+// Dense layer with the weights stored row-wise, one row per output, and the activation applied to each output
+template <size_t NInputs, size_t NOutputs, KernelActivation Activation>
+inline void dense_layer(const double (&weights)[NOutputs][NInputs], const double (&bias)[NOutputs], double alpha, const double* inputs, double* outputs)
+{
+    for(size_t o = 0; o < NOutputs; o++)
+    {
+        double sum = bias[o];
+        for(size_t i = 0; i < NInputs; i++) sum += weights[o][i] * inputs[i];
+        outputs[o] = activate<Activation>(sum, alpha);
+    }
+    if(Activation == KernelActivation::Softmax) softmax<NOutputs>(outputs);
+}
+
+template <size_t N, KernelActivation Activation>
+inline void normalization_layer(const double (&weights)[N], const double (&bias)[N], double alpha, const double* inputs, double* outputs)
+{
+    for(size_t n = 0; n < N; n++) outputs[n] = activate<Activation>((inputs[n] + bias[n]) * weights[n], alpha);
+    if(Activation == KernelActivation::Softmax) softmax<N>(outputs);
+}
+
+// Description of a generated kernel, registered under its name by the generated header
+struct GeneratedKernel
+{
+    // lwtnn config and output node the kernel was generated from
+    std::string source;
+    std::string output_node;
+    std::vector<std::string> input_names;
+    std::vector<std::string> output_labels;
+    // Computes the outputs of a single event from its unnormalized inputs
+    void (*compute)(const double* inputs, double* outputs);
+};
+
+inline std::map<std::string, GeneratedKernel>& generated_kernels()
+{
+    static std::map<std::string, GeneratedKernel> kernels;
+    return kernels;
+}
+
+inline bool register_generated_kernel(const std::string& name, const GeneratedKernel& kernel)
+{
+    generated_kernels()[name] = kernel;
+    return true;
+}
+
+#endif
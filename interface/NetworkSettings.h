@@ -0,0 +1,56 @@
+#ifndef FRIEND_TREE_PRODUCER_NETWORKSETTINGS_H
+#define FRIEND_TREE_PRODUCER_NETWORKSETTINGS_H
+
+#include <boost/program_options.hpp>
+
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "HiggsAnalysis/friend-tree-producer/interface/DenseNetwork.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/GeneratedNetwork.h"
+
+// Evaluation settings of the networks of the NN producers
+struct NetworkSettings
+{
+    // Use the kernels generated by generate_network_kernels.py instead of the lwtnn configs
+    bool generated_kernels = false;
+    // Arithmetic of the network evaluation: double, float or int8
+    std::string precision = "double";
+};
+
+inline void add_network_options(boost::program_options::options_description& config, NetworkSettings& settings)
+{
+    namespace po = boost::program_options;
+    config.add_options()
+        ("generated_kernels", po::bool_switch(&settings.generated_kernels), "use the network kernels generated by generate_network_kernels.py")
+        ("precision", po::value<std::string>(&settings.precision)->default_value(settings.precision), "arithmetic of the networks: double, float or int8");
+}
+
+// Network of an lwtnn config, either evaluated by the generated kernel with the given name, or by a DenseNetwork with the configured precision.
+// Kernel names follow the convention NNMass, NNrecoil and NNScore_<year>_<channel>_fold<fold>.
+inline std::unique_ptr<NeuralNetwork> load_network(const std::string& lwtnn_json, const std::string& output_node, const std::string& kernel_name, const NetworkSettings& settings)
+{
+    const NetworkPrecision precision = network_precision(settings.precision);
+    if(settings.generated_kernels)
+    {
+        if(precision != NetworkPrecision::Double) throw std::runtime_error("Generated kernels are only available in double precision.");
+        // The kernels are not generated by scram, an empty interface/generated means the script was never run
+        if(generated_kernels().size() == 0)
+        {
+            throw std::runtime_error("--generated_kernels is set, but no network kernels were generated. Please run scripts/generate_network_kernels.py "
+                                     "for the models of the producers and recompile with scram b, see README.md.");
+        }
+        return std::unique_ptr<NeuralNetwork>(new GeneratedNetwork(kernel_name));
+    }
+    std::unique_ptr<DenseNetwork> network = load_dense_network(lwtnn_json, output_node);
+    if(precision != NetworkPrecision::Double)
+    {
+        network->set_precision(precision);
+        std::cout << "Evaluating " << lwtnn_json << " in " << settings.precision << " precision with " << simd_instruction_set() << " kernels" << std::endl;
+    }
+    return std::unique_ptr<NeuralNetwork>(network.release());
+}
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef FRIEND_TREE_PRODUCER_NEURALNETWORK_H
+#define FRIEND_TREE_PRODUCER_NEURALNETWORK_H
+
+#include <Eigen/Dense>
+
+#include <string>
+#include <vector>
+
+// Common interface of the batch-wise network implementations, DenseNetwork and the generated kernels.
+//
+// The inputs are given as a matrix with one row per input variable, in the order of input_names(),
+// and one column per event. The outputs have one row per output label.
+class NeuralNetwork
+{
+  public:
+    virtual ~NeuralNetwork() {}
+
+    size_t n_inputs() const { return input_names_.size(); }
+    size_t n_outputs() const { return output_labels_.size(); }
+    const std::vector<std::string>& input_names() const { return input_names_; }
+    const std::vector<std::string>& output_labels() const { return output_labels_; }
+
+    virtual void compute(const Eigen::MatrixXd& inputs, Eigen::MatrixXd& outputs) const = 0;
+
+  protected:
+    std::vector<std::string> input_names_;
+    std::vector<std::string> output_labels_;
+};
+
+#endif
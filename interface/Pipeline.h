@@ -0,0 +1,302 @@
+#ifndef FRIEND_TREE_PRODUCER_PIPELINE_H
+#define FRIEND_TREE_PRODUCER_PIPELINE_H
+
+#include "TROOT.h"
+
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "HiggsAnalysis/friend-tree-producer/interface/ColumnReader.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/FriendProducer.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/FriendTreeWriter.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/JobMetrics.h"
+
+// Pipeline settings shared by all friend tree executables
+struct PipelineSettings
+{
+    // Read, compute and write the blocks of a task on separate threads
+    bool enabled = false;
+    // Number of blocks buffered between two stages of the pipeline
+    unsigned int queue_size = 4;
+    // Threads of the compute stage. The producers are distributed over the workers, each producer runs on a single worker.
+    unsigned int compute_workers = 1;
+};
+
+inline void add_pipeline_options(boost::program_options::options_description& config, PipelineSettings& settings)
+{
+    namespace po = boost::program_options;
+    config.add_options()
+        ("pipeline", po::bool_switch(&settings.enabled), "read, compute and write the blocks of entries on separate threads")
+        ("pipeline_queue", po::value<unsigned int>(&settings.queue_size)->default_value(settings.queue_size), "blocks buffered between the stages of the pipeline")
+        ("compute_workers", po::value<unsigned int>(&settings.compute_workers)->default_value(settings.compute_workers), "threads of the compute stage of the pipeline, each running a subset of the producers");
+}
+
+// Bounded queue between exactly one producing and one consuming thread. Without locks, the two threads only
+// synchronize on the positions of the ring buffer. Blocking calls spin briefly and then back off with
+// increasing sleeps, such that a stage waiting for a slow neighbour does not occupy a core.
+// After close(), push() fails and pop() fails as soon as the queue is empty.
+template <typename T>
+class SpscQueue
+{
+  public:
+    explicit SpscQueue(size_t capacity) : slots_(std::max<size_t>(capacity, 1) + 1), head_(0), tail_(0), closed_(false) {}
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    bool try_push(T& value)
+    {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        const size_t next = (tail + 1) % slots_.size();
+        if(next == head_.load(std::memory_order_acquire)) return false;
+        slots_[tail] = std::move(value);
+        tail_.store(next, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(T& value)
+    {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if(head == tail_.load(std::memory_order_acquire)) return false;
+        value = std::move(slots_[head]);
+        slots_[head] = T();
+        head_.store((head + 1) % slots_.size(), std::memory_order_release);
+        return true;
+    }
+
+    bool push(T value)
+    {
+        for(unsigned int attempt = 0; !try_push(value); attempt++)
+        {
+            if(closed()) return false;
+            back_off(attempt);
+        }
+        return true;
+    }
+
+    bool pop(T& value)
+    {
+        for(unsigned int attempt = 0; !try_pop(value); attempt++)
+        {
+            // Items pushed before close() are still handed out
+            if(closed()) return try_pop(value);
+            back_off(attempt);
+        }
+        return true;
+    }
+
+    void close() { closed_.store(true, std::memory_order_release); }
+    bool closed() const { return closed_.load(std::memory_order_acquire); }
+
+  private:
+    static void back_off(unsigned int attempt)
+    {
+        if(attempt < 64) return;
+        if(attempt < 128) std::this_thread::yield();
+        else std::this_thread::sleep_for(std::chrono::microseconds(std::min(1000u, 10u * (attempt - 127))));
+    }
+
+    std::vector<T> slots_;
+    std::atomic<size_t> head_;
+    std::atomic<size_t> tail_;
+    std::atomic<bool> closed_;
+};
+
+// Columns with the event numbers of the rows of sparse outputs
+struct EventNumberColumns
+{
+    InputColumn<UInt_t> run;
+    InputColumn<UInt_t> lumi;
+    InputColumn<ULong64_t> event;
+};
+
+// Reads a block of entries: the branches needed for all entries, the selections of the producers and
+// the branches of the selected entries
+inline void read_block(ColumnReader& reader, const std::vector<FriendProducer*>& producers, Long64_t first_entry, size_t size, InputBlock& inputs,
+                       std::vector<std::vector<bool>>& selections, double& read_seconds, double& select_seconds)
+{
+    {
+        ScopedTimer timer(read_seconds);
+        reader.read(first_entry, size, inputs);
+    }
+    {
+        ScopedTimer timer(select_seconds);
+        selections.resize(producers.size());
+        for(size_t p = 0; p < producers.size(); p++)
+        {
+            selections[p].assign(size, true);
+            producers[p]->select(inputs, selections[p]);
+        }
+    }
+    {
+        ScopedTimer timer(read_seconds);
+        reader.read_selected(inputs, selections);
+    }
+}
+
+// Computes the outputs of a producer for a block, with the event numbers of the selected rows for sparse outputs
+inline void compute_block(FriendProducer& producer, const OutputSchema& schema, const InputBlock& inputs, const std::vector<bool>& selected,
+                          const EventNumberColumns* event_numbers, OutputBlock& outputs)
+{
+    outputs.reset(schema, inputs.size());
+    producer.compute(inputs, selected, outputs);
+    if(event_numbers)
+    {
+        SparseRows& rows = outputs.sparse_rows();
+        rows.first_entry = inputs.first_entry();
+        rows.selected = selected;
+        rows.run = inputs.get(event_numbers->run);
+        rows.lumi = inputs.get(event_numbers->lumi);
+        rows.event = inputs.get(event_numbers->event);
+    }
+}
+
+// Block of entries passed through the pipeline, with its inputs, the selections and the outputs of all producers
+struct PipelineBlock
+{
+    InputBlock inputs;
+    std::vector<std::vector<bool>> selections;
+    std::vector<OutputBlock> outputs;
+};
+
+// Event loop of a task in three stages, connected by bounded SpscQueues of blocks:
+// - the reader thread reads and decompresses the blocks and evaluates the selections of the producers,
+// - the compute workers run the producers, each worker a fixed subset of them on every block,
+// - the calling thread fills the outputs of complete blocks into the friend trees.
+//
+// Each producer computes all blocks in entry order on a single thread, as in the sequential event loop, and the blocks
+// are filled in entry order, so the outputs do not depend on the pipeline. Only select(), which does not modify the
+// producer, runs on the reader thread concurrently to compute(). Processed blocks are returned to the reader for reuse.
+// The writer has to fill on the calling thread, i.e. without writer_queue. Returns the number of processed entries.
+inline size_t run_pipeline(const std::vector<FriendProducer*>& producers, const std::vector<OutputSchema>& output_schemas, ColumnReader& reader,
+                           FriendTreeOutputs& writer, const ProducerTask& task, unsigned int block_size, const PipelineSettings& settings,
+                           const EventNumberColumns* event_numbers, StageTimes& stages, std::vector<double>& compute_seconds)
+{
+    typedef std::shared_ptr<PipelineBlock> BlockPointer;
+    // Input and output files are accessed from different threads
+    ROOT::EnableThreadSafety();
+    const size_t workers = std::max<size_t>(1, std::min<size_t>(settings.compute_workers, producers.size()));
+    std::vector<std::unique_ptr<SpscQueue<BlockPointer>>> computing, writing;
+    for(size_t w = 0; w < workers; w++)
+    {
+        computing.emplace_back(new SpscQueue<BlockPointer>(settings.queue_size));
+        writing.emplace_back(new SpscQueue<BlockPointer>(settings.queue_size));
+    }
+    // Large enough for all blocks in flight, further blocks are released
+    SpscQueue<BlockPointer> recycled(2 * settings.queue_size + workers + 2);
+
+    // The first exception of any stage stops all stages and is rethrown on the calling thread
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    std::atomic<bool> failed(false);
+    auto fail = [&]() {
+        {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if(!error) error = std::current_exception();
+        }
+        failed = true;
+        for(size_t w = 0; w < workers; w++)
+        {
+            computing[w]->close();
+            writing[w]->close();
+        }
+    };
+
+    double read_seconds = 0.0;
+    double select_seconds = 0.0;
+    std::thread reader_thread([&]() {
+        try
+        {
+            for(Long64_t block_first = task.first_entry; block_first <= task.last_entry && !failed; block_first += block_size)
+            {
+                BlockPointer block;
+                if(!recycled.try_pop(block)) block = std::make_shared<PipelineBlock>();
+                const size_t size = std::min<Long64_t>(block_size, task.last_entry - block_first + 1);
+                read_block(reader, producers, block_first, size, block->inputs, block->selections, read_seconds, select_seconds);
+                block->outputs.resize(producers.size());
+                // Every worker gets every block
+                for(size_t w = 0; w < workers; w++) computing[w]->push(block);
+            }
+        }
+        catch(...)
+        {
+            fail();
+        }
+        for(size_t w = 0; w < workers; w++) computing[w]->close();
+    });
+
+    std::vector<double> wait_seconds(workers, 0.0);
+    std::vector<std::thread> worker_threads;
+    for(size_t w = 0; w < workers; w++)
+    {
+        worker_threads.emplace_back([&, w]() {
+            try
+            {
+                BlockPointer block;
+                while(true)
+                {
+                    {
+                        ScopedTimer timer(wait_seconds[w]);
+                        if(!computing[w]->pop(block) || failed) break;
+                    }
+                    for(size_t p = w; p < producers.size(); p += workers)
+                    {
+                        ScopedTimer timer(compute_seconds[p]);
+                        compute_block(*producers[p], output_schemas[p], block->inputs, block->selections[p], event_numbers, block->outputs[p]);
+                    }
+                    writing[w]->push(std::move(block));
+                    block.reset();
+                }
+            }
+            catch(...)
+            {
+                fail();
+            }
+            writing[w]->close();
+        });
+    }
+
+    // The workers hand over the same blocks in the same order, a block is complete when received from all of them
+    size_t events = 0;
+    try
+    {
+        std::vector<BlockPointer> blocks(workers);
+        while(!failed)
+        {
+            bool complete = true;
+            for(size_t w = 0; w < workers; w++) complete = writing[w]->pop(blocks[w]) && complete;
+            if(!complete || failed) break;
+            BlockPointer block = blocks[0];
+            for(auto& worker_block : blocks) worker_block.reset();
+            writer.write(block->outputs);
+            events += block->inputs.size();
+            recycled.try_push(block);
+        }
+    }
+    catch(...)
+    {
+        fail();
+    }
+
+    reader_thread.join();
+    for(auto& worker_thread : worker_threads) worker_thread.join();
+    if(error) std::rethrow_exception(error);
+
+    stages["read"] = read_seconds;
+    stages["select"] = select_seconds;
+    // Time of the compute workers waiting for blocks of the reader, summed over the workers
+    double compute_wait = 0.0;
+    for(const auto& seconds : wait_seconds) compute_wait += seconds;
+    stages["compute_wait"] = compute_wait;
+    return events;
+}
+
+#endif
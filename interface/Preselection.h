@@ -0,0 +1,291 @@
+#ifndef FRIEND_TREE_PRODUCER_PRESELECTION_H
+#define FRIEND_TREE_PRODUCER_PRESELECTION_H
+
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "HiggsAnalysis/friend-tree-producer/interface/FriendProducer.h"
+
+// Selection of the events, for which a producer runs its computation, given as expression of input branches, e.g.
+// "iso_1 < 0.15 && q_1 * q_2 < 0 && mt_1 < 70". The expression supports numbers, branch names, the arithmetic operators
+// + - * /, comparisons < <= > >= == !=, the logical operators && || !, parentheses and abs(). Comparisons and logical
+// operators evaluate to 1 or 0, and an event passes the selection if the expression is non-zero.
+//
+// The expression is parsed once into a postfix program. For each task, its branches are bound to input columns of their type,
+// and the program is evaluated for all events of a block at once, with one array of values per operand.
+class Preselection
+{
+  public:
+    explicit Preselection(const std::string& expression = "") : expression_(expression), position_(0), n_passed_(0), n_failed_(0)
+    {
+        if(!enabled()) return;
+        parse_or();
+        skip_spaces();
+        if(position_ != expression_.size()) error("unexpected " + expression_.substr(position_));
+    }
+
+    bool enabled() const { return expression_.find_first_not_of(" \t") != std::string::npos; }
+    const std::string& expression() const { return expression_; }
+
+    // Declares the branches of the expression, which are read for all entries, and resets the counts
+    void declare(InputSchema& inputs)
+    {
+        n_passed_ = 0;
+        n_failed_ = 0;
+        for(auto& variable : variables_)
+        {
+            const std::string type = inputs.type_name(variable.branch);
+            if(type == column_type_name<Float_t>()) variable.bind(inputs.add<Float_t>(variable.branch));
+            else if(type == column_type_name<Double_t>()) variable.bind(inputs.add<Double_t>(variable.branch));
+            else if(type == column_type_name<Int_t>()) variable.bind(inputs.add<Int_t>(variable.branch));
+            else if(type == column_type_name<UInt_t>()) variable.bind(inputs.add<UInt_t>(variable.branch));
+            else if(type == column_type_name<ULong64_t>()) variable.bind(inputs.add<ULong64_t>(variable.branch));
+            else throw std::runtime_error("Branch " + variable.branch + " of the preselection has unsupported type " + type + ".");
+        }
+    }
+
+    // Unsets the entries of the block failing the selection
+    void evaluate(const InputBlock& inputs, std::vector<bool>& selected) const
+    {
+        if(!enabled()) return;
+        const size_t size = inputs.size();
+        std::vector<std::vector<double>> stack;
+        for(const auto& instruction : program_)
+        {
+            if(instruction.operation == Operation::Constant || instruction.operation == Operation::Variable)
+            {
+                stack.emplace_back();
+                if(instruction.operation == Operation::Constant) stack.back().assign(size, instruction.constant);
+                else variables_[instruction.variable].load(inputs, stack.back());
+                continue;
+            }
+            std::vector<double>& a = stack[stack.size() - (is_unary(instruction.operation) ? 1 : 2)];
+            const std::vector<double>& b = stack.back();
+            switch(instruction.operation)
+            {
+                case Operation::Negate: for(size_t k = 0; k < size; k++) a[k] = -a[k]; break;
+                case Operation::Not: for(size_t k = 0; k < size; k++) a[k] = a[k] == 0.0; break;
+                case Operation::Abs: for(size_t k = 0; k < size; k++) a[k] = std::fabs(a[k]); break;
+                case Operation::Add: for(size_t k = 0; k < size; k++) a[k] += b[k]; break;
+                case Operation::Subtract: for(size_t k = 0; k < size; k++) a[k] -= b[k]; break;
+                case Operation::Multiply: for(size_t k = 0; k < size; k++) a[k] *= b[k]; break;
+                case Operation::Divide: for(size_t k = 0; k < size; k++) a[k] /= b[k]; break;
+                case Operation::Less: for(size_t k = 0; k < size; k++) a[k] = a[k] < b[k]; break;
+                case Operation::LessEqual: for(size_t k = 0; k < size; k++) a[k] = a[k] <= b[k]; break;
+                case Operation::Greater: for(size_t k = 0; k < size; k++) a[k] = a[k] > b[k]; break;
+                case Operation::GreaterEqual: for(size_t k = 0; k < size; k++) a[k] = a[k] >= b[k]; break;
+                case Operation::Equal: for(size_t k = 0; k < size; k++) a[k] = a[k] == b[k]; break;
+                case Operation::NotEqual: for(size_t k = 0; k < size; k++) a[k] = a[k] != b[k]; break;
+                case Operation::And: for(size_t k = 0; k < size; k++) a[k] = a[k] != 0.0 && b[k] != 0.0; break;
+                case Operation::Or: for(size_t k = 0; k < size; k++) a[k] = a[k] != 0.0 || b[k] != 0.0; break;
+                default: break;
+            }
+            if(!is_unary(instruction.operation)) stack.pop_back();
+        }
+        for(size_t k = 0; k < size; k++) selected[k] = selected[k] && stack.back()[k] != 0.0;
+    }
+
+    // Counts an event for the summary, given whether it passed the selection in evaluate()
+    void count(bool passed) { passed ? n_passed_++ : n_failed_++; }
+
+    std::string summary() const
+    {
+        return "preselection " + expression_ + " passed by " + std::to_string(n_passed_) + " events, failed by " + std::to_string(n_failed_) + " events";
+    }
+
+  private:
+    enum class Operation { Constant, Variable, Negate, Not, Abs, Add, Subtract, Multiply, Divide, Less, LessEqual, Greater, GreaterEqual, Equal, NotEqual, And, Or };
+
+    struct Instruction
+    {
+        Operation operation;
+        double constant;
+        size_t variable;
+    };
+
+    // Branch of the expression, bound to the input column of its type
+    struct Variable
+    {
+        std::string branch;
+        size_t type;
+        size_t index;
+
+        template <typename T>
+        void bind(InputColumn<T> column)
+        {
+            type = index_of<T>();
+            index = column.index;
+        }
+
+        void load(const InputBlock& inputs, std::vector<double>& values) const
+        {
+            if(type == index_of<Float_t>()) load<Float_t>(inputs, values);
+            else if(type == index_of<Double_t>()) load<Double_t>(inputs, values);
+            else if(type == index_of<Int_t>()) load<Int_t>(inputs, values);
+            else if(type == index_of<UInt_t>()) load<UInt_t>(inputs, values);
+            else load<ULong64_t>(inputs, values);
+        }
+
+        template <typename T>
+        void load(const InputBlock& inputs, std::vector<double>& values) const
+        {
+            const std::vector<T>& column = inputs.get(InputColumn<T>{index});
+            values.assign(column.begin(), column.end());
+        }
+
+        template <typename T>
+        static size_t index_of()
+        {
+            if(std::is_same<T, Float_t>::value) return 0;
+            if(std::is_same<T, Double_t>::value) return 1;
+            if(std::is_same<T, Int_t>::value) return 2;
+            if(std::is_same<T, UInt_t>::value) return 3;
+            return 4;
+        }
+    };
+
+    static bool is_unary(Operation operation) { return operation == Operation::Negate || operation == Operation::Not || operation == Operation::Abs; }
+
+    void error(const std::string& message) const
+    {
+        throw std::runtime_error("Invalid preselection \"" + expression_ + "\" at position " + std::to_string(position_) + ": " + message);
+    }
+
+    void skip_spaces()
+    {
+        while(position_ < expression_.size() && std::isspace(expression_[position_])) position_++;
+    }
+
+    // Consumes the given token, if it follows
+    bool accept(const std::string& token)
+    {
+        skip_spaces();
+        if(expression_.compare(position_, token.size(), token) != 0) return false;
+        position_ += token.size();
+        return true;
+    }
+
+    void emit(Operation operation) { program_.push_back(Instruction{operation, 0.0, 0}); }
+
+    void parse_or()
+    {
+        parse_and();
+        while(accept("||"))
+        {
+            parse_and();
+            emit(Operation::Or);
+        }
+    }
+
+    void parse_and()
+    {
+        parse_comparison();
+        while(accept("&&"))
+        {
+            parse_comparison();
+            emit(Operation::And);
+        }
+    }
+
+    void parse_comparison()
+    {
+        parse_sum();
+        // Two-character operators first, such that <= is not taken as <
+        const std::vector<std::pair<std::string, Operation>> comparisons = {{"<=", Operation::LessEqual}, {">=", Operation::GreaterEqual}, {"==", Operation::Equal},
+                                                                            {"!=", Operation::NotEqual}, {"<", Operation::Less}, {">", Operation::Greater}};
+        for(const auto& comparison : comparisons)
+        {
+            if(accept(comparison.first))
+            {
+                parse_sum();
+                emit(comparison.second);
+                return;
+            }
+        }
+    }
+
+    void parse_sum()
+    {
+        parse_product();
+        while(true)
+        {
+            if(accept("+")) { parse_product(); emit(Operation::Add); }
+            else if(accept("-")) { parse_product(); emit(Operation::Subtract); }
+            else return;
+        }
+    }
+
+    void parse_product()
+    {
+        parse_unary();
+        while(true)
+        {
+            if(accept("*")) { parse_unary(); emit(Operation::Multiply); }
+            else if(accept("/")) { parse_unary(); emit(Operation::Divide); }
+            else return;
+        }
+    }
+
+    void parse_unary()
+    {
+        skip_spaces();
+        // A single ! negates, != is a comparison
+        if(expression_.compare(position_, 2, "!=") != 0 && accept("!")) { parse_unary(); emit(Operation::Not); }
+        else if(accept("-")) { parse_unary(); emit(Operation::Negate); }
+        else if(accept("+")) parse_unary();
+        else parse_primary();
+    }
+
+    void parse_primary()
+    {
+        skip_spaces();
+        if(position_ == expression_.size()) error("unexpected end of expression");
+        const char c = expression_[position_];
+        if(accept("("))
+        {
+            parse_or();
+            if(!accept(")")) error("missing )");
+        }
+        else if(std::isdigit(c) || c == '.')
+        {
+            const char* begin = expression_.c_str() + position_;
+            char* end = nullptr;
+            const double constant = std::strtod(begin, &end);
+            position_ += end - begin;
+            program_.push_back(Instruction{Operation::Constant, constant, 0});
+        }
+        else if(std::isalpha(c) || c == '_')
+        {
+            const size_t begin = position_;
+            while(position_ < expression_.size() && (std::isalnum(expression_[position_]) || expression_[position_] == '_')) position_++;
+            const std::string name = expression_.substr(begin, position_ - begin);
+            if(name == "abs" && accept("("))
+            {
+                parse_or();
+                if(!accept(")")) error("missing )");
+                emit(Operation::Abs);
+                return;
+            }
+            size_t variable = 0;
+            while(variable < variables_.size() && variables_[variable].branch != name) variable++;
+            if(variable == variables_.size()) variables_.push_back(Variable{name, 0, 0});
+            program_.push_back(Instruction{Operation::Variable, 0.0, variable});
+        }
+        else error(std::string("unexpected ") + c);
+    }
+
+    std::string expression_;
+    size_t position_;
+    std::vector<Instruction> program_;
+    std::vector<Variable> variables_;
+    unsigned long n_passed_;
+    unsigned long n_failed_;
+};
+
+#endif
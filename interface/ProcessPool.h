@@ -0,0 +1,201 @@
+#ifndef FRIEND_TREE_PRODUCER_PROCESSPOOL_H
+#define FRIEND_TREE_PRODUCER_PROCESSPOOL_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <poll.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Pool of forked worker processes for computations with state that is not thread-safe, e.g. Fortran common blocks.
+//
+// The state is initialized once in the parent, and the workers inherit it at fork. Each worker owns a shared memory
+// region holding one chunk of inputs and results. The parent copies a chunk of inputs into the region and sends its size
+// through a request pipe; the worker computes the results in place and answers through a response pipe. The pool has to
+// be created before any other threads are started, since only the forking thread is duplicated in the workers.
+template <typename Input, typename Result>
+class ProcessPool
+{
+    static_assert(std::is_trivially_copyable<Input>::value && std::is_trivially_copyable<Result>::value,
+                  "Inputs and results of a ProcessPool have to be trivially copyable.");
+
+  public:
+    typedef std::function<void(const Input&, Result&)> Function;
+
+    ProcessPool(unsigned int n_workers, size_t chunk_size, Function function) : chunk_size_(chunk_size), function_(function)
+    {
+        // A stopped worker is reported by an exception instead of terminating the parent
+        signal(SIGPIPE, SIG_IGN);
+        // Avoid printing buffered output once more from each worker
+        std::cout.flush();
+        std::cerr.flush();
+        for(unsigned int w = 0; w < n_workers; w++)
+        {
+            Worker worker;
+            worker.memory = mmap(nullptr, memory_size(), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+            if(worker.memory == MAP_FAILED) throw std::runtime_error("Could not map shared memory for worker: " + std::string(std::strerror(errno)));
+            int request[2], response[2];
+            if(pipe(request) != 0 || pipe(response) != 0) throw std::runtime_error("Could not create pipes for worker: " + std::string(std::strerror(errno)));
+            worker.pid = fork();
+            if(worker.pid < 0) throw std::runtime_error("Could not fork worker: " + std::string(std::strerror(errno)));
+            if(worker.pid == 0)
+            {
+                // Close the pipes of the previous workers, such that they see the end of their request pipe with the parent
+                for(const auto& other : workers_)
+                {
+                    close(other.request);
+                    close(other.response);
+                }
+                close(request[1]);
+                close(response[0]);
+                serve(request[0], response[1], worker.memory);
+            }
+            close(request[0]);
+            close(response[1]);
+            worker.request = request[1];
+            worker.response = response[0];
+            workers_.push_back(worker);
+        }
+    }
+
+    ~ProcessPool()
+    {
+        // Closing the request pipes stops the workers
+        for(const auto& worker : workers_)
+        {
+            close(worker.request);
+            close(worker.response);
+        }
+        for(const auto& worker : workers_)
+        {
+            waitpid(worker.pid, nullptr, 0);
+            munmap(worker.memory, memory_size());
+        }
+    }
+
+    size_t size() const { return workers_.size(); }
+
+    // Computes the results of all inputs on the workers. The results are returned in the order of the inputs.
+    void run(const std::vector<Input>& inputs, std::vector<Result>& results)
+    {
+        results.resize(inputs.size());
+        std::vector<size_t> chunk_first(workers_.size(), 0);
+        std::vector<uint32_t> chunk_size(workers_.size(), 0);
+        size_t next = 0;
+        size_t n_busy = 0;
+        while(next < inputs.size() || n_busy > 0)
+        {
+            // Hand over chunks to all idle workers
+            for(size_t w = 0; w < workers_.size() && next < inputs.size(); w++)
+            {
+                if(chunk_size[w] > 0) continue;
+                chunk_first[w] = next;
+                chunk_size[w] = std::min(chunk_size_, inputs.size() - next);
+                std::memcpy(workers_[w].memory, &inputs[next], chunk_size[w] * sizeof(Input));
+                transfer(workers_[w].request, &chunk_size[w], false);
+                next += chunk_size[w];
+                n_busy++;
+            }
+
+            // Wait for finished workers and collect their results
+            std::vector<pollfd> descriptors;
+            for(size_t w = 0; w < workers_.size(); w++)
+            {
+                if(chunk_size[w] > 0) descriptors.push_back({workers_[w].response, POLLIN, 0});
+            }
+            if(poll(descriptors.data(), descriptors.size(), -1) < 0)
+            {
+                if(errno == EINTR) continue;
+                throw std::runtime_error("Could not wait for workers: " + std::string(std::strerror(errno)));
+            }
+            for(size_t w = 0; w < workers_.size(); w++)
+            {
+                if(chunk_size[w] == 0) continue;
+                auto descriptor = std::find_if(descriptors.begin(), descriptors.end(), [&](const pollfd& d) { return d.fd == workers_[w].response; });
+                if(descriptor->revents == 0) continue;
+                uint32_t done = 0;
+                transfer(workers_[w].response, &done, true);
+                if(done != chunk_size[w]) throw std::runtime_error("Worker " + std::to_string(workers_[w].pid) + " returned an incomplete chunk.");
+                std::memcpy(&results[chunk_first[w]], result_memory(workers_[w].memory), chunk_size[w] * sizeof(Result));
+                chunk_size[w] = 0;
+                n_busy--;
+            }
+        }
+    }
+
+  private:
+    struct Worker
+    {
+        pid_t pid;
+        int request;
+        int response;
+        void* memory;
+    };
+
+    size_t memory_size() const { return chunk_size_ * (sizeof(Input) + sizeof(Result)); }
+    void* result_memory(void* memory) const { return static_cast<char*>(memory) + chunk_size_ * sizeof(Input); }
+
+    // Reads or writes a single chunk size through a pipe. A closed pipe means that the other process has stopped.
+    static bool transfer(int descriptor, uint32_t* value, bool reading, bool throw_on_close = true)
+    {
+        char* bytes = reinterpret_cast<char*>(value);
+        size_t done = 0;
+        while(done < sizeof(uint32_t))
+        {
+            const ssize_t n = reading ? read(descriptor, bytes + done, sizeof(uint32_t) - done) : write(descriptor, bytes + done, sizeof(uint32_t) - done);
+            if(n < 0 && errno == EINTR) continue;
+            if(n <= 0)
+            {
+                if(!throw_on_close) return false;
+                throw std::runtime_error("Lost connection to worker process.");
+            }
+            done += n;
+        }
+        return true;
+    }
+
+    // Main loop of a worker process, which never returns
+    [[noreturn]] void serve(int request, int response, void* memory)
+    {
+        // Do not take over interrupts of the terminal; the worker stops as soon as the parent closes the pipe
+        signal(SIGINT, SIG_IGN);
+        const Input* inputs = static_cast<const Input*>(memory);
+        Result* results = static_cast<Result*>(result_memory(memory));
+        int status = 0;
+        try
+        {
+            uint32_t size = 0;
+            while(transfer(request, &size, true, false))
+            {
+                for(uint32_t k = 0; k < size; k++) function_(inputs[k], results[k]);
+                std::cout.flush();
+                transfer(response, &size, false);
+            }
+        }
+        catch(const std::exception& e)
+        {
+            std::cerr << "Worker process " << getpid() << " failed: " << e.what() << std::endl;
+            status = 1;
+        }
+        // Leave without running destructors of the state shared with the parent, e.g. open files
+        std::cout.flush();
+        _exit(status);
+    }
+
+    size_t chunk_size_;
+    Function function_;
+    std::vector<Worker> workers_;
+};
+
+#endif
@@ -0,0 +1,263 @@
+#ifndef FRIEND_TREE_PRODUCER_RESULTCACHE_H
+#define FRIEND_TREE_PRODUCER_RESULTCACHE_H
+
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <boost/filesystem.hpp>
+
+// FNV-1a hash of a byte range
+inline uint64_t fnv1a_hash(const void* data, size_t size, uint64_t hash = 14695981039346656037ULL)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for(size_t b = 0; b < size; b++)
+    {
+        hash ^= bytes[b];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Hash and comparison of plain structs by their exact bytes. The structs must not contain padding.
+template <typename T>
+struct BytewiseHash
+{
+    size_t operator()(const T& value) const { return fnv1a_hash(&value, sizeof(T)); }
+};
+
+template <typename T>
+struct BytewiseEqual
+{
+    bool operator()(const T& a, const T& b) const { return std::memcmp(&a, &b, sizeof(T)) == 0; }
+};
+
+// Sample of an input file for the cache file names, i.e. the file name without extension, restricted to characters safe in file names
+inline std::string cache_sample(const std::string& input)
+{
+    std::string sample = boost::filesystem::path(input).stem().string();
+    for(auto& c : sample)
+    {
+        if(!std::isalnum(static_cast<unsigned char>(c)) && c != '_' && c != '-' && c != '.') c = '_';
+    }
+    return sample;
+}
+
+// Persistent key-value store of producer results, addressed by the exact input values of an event.
+//
+// All records of one producer configuration and input sample are appended to a single file
+// <cache_dir>/<producer>_<sample>_<configuration hash>.cache, which is shared by all jobs
+// on that sample. Identical inputs only recur within a sample, such that a job loads only the
+// results it can use, instead of those of the whole campaign. The file is read completely when the cache is opened; new results are
+// buffered and appended under an exclusive file lock on flush(). Each record carries a
+// checksum, such that records from interrupted writes are ignored when reading and
+// overwritten by the next flush.
+template <typename Key, typename Value>
+class ResultCache
+{
+  public:
+    ResultCache(const std::string& cache_dir, const std::string& producer, const std::string& sample, const std::string& configuration)
+        : configuration_(configuration), n_loaded_(0), n_hits_(0), n_stored_(0)
+    {
+        if(cache_dir == "") return;
+        boost::filesystem::create_directories(cache_dir);
+        std::stringstream filename;
+        filename << producer << "_" << sample << "_" << std::hex << std::setw(16) << std::setfill('0') << fnv1a_hash(configuration.data(), configuration.size()) << ".cache";
+        path_ = (boost::filesystem::path(cache_dir) / filename.str()).string();
+        load();
+    }
+
+    ~ResultCache() { flush(); }
+
+    bool enabled() const { return path_ != ""; }
+
+    bool get(const Key& key, Value& value)
+    {
+        auto result = results_.find(key);
+        if(result == results_.end()) return false;
+        value = result->second;
+        n_hits_++;
+        return true;
+    }
+
+    void put(const Key& key, const Value& value)
+    {
+        if(!enabled() || !results_.emplace(key, value).second) return;
+        Record record;
+        std::memset(&record, 0, sizeof(Record));
+        std::memcpy(record.key, &key, sizeof(Key));
+        std::memcpy(record.value, &value, sizeof(Value));
+        record.checksum = fnv1a_hash(&record, offsetof(Record, checksum));
+        pending_.push_back(record);
+    }
+
+    // Append the results stored since the last flush to the cache file. Only completely written records count as stored.
+    void flush()
+    {
+        if(!enabled() || pending_.size() == 0) return;
+        int fd = open(path_.c_str(), O_WRONLY);
+        if(fd < 0)
+        {
+            std::cout << "WARNING: Could not write to cache file " << path_ << std::endl;
+            pending_.clear();
+            return;
+        }
+        if(flock(fd, LOCK_EX) != 0)
+        {
+            std::cout << "WARNING: Could not lock cache file " << path_ << ". " << pending_.size() << " new results are not stored." << std::endl;
+            close(fd);
+            pending_.clear();
+            return;
+        }
+        // Start behind the last complete record, overwriting the remainder of an interrupted write
+        struct stat file_status;
+        const off_t offset = sizeof(Header) + configuration_.size();
+        if(fstat(fd, &file_status) != 0 || file_status.st_size < offset)
+        {
+            std::cout << "WARNING: Could not determine the size of cache file " << path_ << ". " << pending_.size() << " new results are not stored." << std::endl;
+            flock(fd, LOCK_UN);
+            close(fd);
+            pending_.clear();
+            return;
+        }
+        const off_t end = offset + (file_status.st_size - offset) / sizeof(Record) * sizeof(Record);
+        size_t written_bytes = 0;
+        if(lseek(fd, end, SEEK_SET) == end)
+        {
+            const char* data = reinterpret_cast<const char*>(pending_.data());
+            const size_t size = pending_.size() * sizeof(Record);
+            while(written_bytes < size)
+            {
+                ssize_t written = write(fd, data + written_bytes, size - written_bytes);
+                if(written <= 0) break;
+                written_bytes += written;
+            }
+        }
+        flock(fd, LOCK_UN);
+        close(fd);
+        const size_t written_records = written_bytes / sizeof(Record);
+        if(written_records < pending_.size())
+        {
+            std::cout << "WARNING: Could not write to cache file " << path_ << ". " << pending_.size() - written_records << " of " << pending_.size() << " new results are not stored." << std::endl;
+        }
+        n_stored_ += written_records;
+        pending_.clear();
+    }
+
+    std::string summary() const
+    {
+        std::stringstream text;
+        text << "cache " << path_ << ": " << n_loaded_ << " results loaded, " << n_hits_ << " used, " << n_stored_ << " new results stored";
+        return text.str();
+    }
+
+  private:
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t key_size;
+        uint32_t value_size;
+        uint32_t configuration_size;
+    };
+
+    struct Record
+    {
+        char key[sizeof(Key)];
+        char value[sizeof(Value)];
+        uint64_t checksum;
+    };
+
+    Header expected_header() const
+    {
+        Header header;
+        std::memset(&header, 0, sizeof(Header));
+        std::memcpy(header.magic, "FTPCACHE", 8);
+        header.version = 1;
+        header.key_size = sizeof(Key);
+        header.value_size = sizeof(Value);
+        header.configuration_size = configuration_.size();
+        return header;
+    }
+
+    void load()
+    {
+        int fd = open(path_.c_str(), O_RDWR | O_CREAT, 0664);
+        if(fd < 0)
+        {
+            std::cout << "WARNING: Could not open cache file " << path_ << ". Running without cache." << std::endl;
+            path_ = "";
+            return;
+        }
+        struct stat file_status;
+        if(flock(fd, LOCK_EX) != 0 || fstat(fd, &file_status) != 0)
+        {
+            std::cout << "WARNING: Could not lock and read cache file " << path_ << ". Running without cache." << std::endl;
+            close(fd);
+            path_ = "";
+            return;
+        }
+        const Header header = expected_header();
+        if(file_status.st_size == 0)
+        {
+            // New cache file: write header and full configuration, such that the file is self-describing
+            if(write(fd, &header, sizeof(Header)) != sizeof(Header) || write(fd, configuration_.data(), configuration_.size()) != static_cast<ssize_t>(configuration_.size()))
+            {
+                std::cout << "WARNING: Could not initialize cache file " << path_ << ". Running without cache." << std::endl;
+                path_ = "";
+            }
+        }
+        else
+        {
+            std::vector<char> content(file_status.st_size);
+            size_t size = 0;
+            ssize_t n_read = 0;
+            while(size < content.size() && (n_read = read(fd, content.data() + size, content.size() - size)) > 0) size += n_read;
+            const size_t offset = sizeof(Header) + configuration_.size();
+            if(size < offset || std::memcmp(content.data(), &header, sizeof(Header)) != 0 || configuration_.compare(0, std::string::npos, content.data() + sizeof(Header), configuration_.size()) != 0)
+            {
+                std::cout << "WARNING: Cache file " << path_ << " does not match the configuration. Running without cache." << std::endl;
+                path_ = "";
+            }
+            else
+            {
+                Record record;
+                for(size_t position = offset; position + sizeof(Record) <= size; position += sizeof(Record))
+                {
+                    std::memcpy(&record, content.data() + position, sizeof(Record));
+                    if(record.checksum != fnv1a_hash(&record, offsetof(Record, checksum))) continue;
+                    Key key;
+                    Value value;
+                    std::memcpy(&key, record.key, sizeof(Key));
+                    std::memcpy(&value, record.value, sizeof(Value));
+                    results_.emplace(key, value);
+                }
+                n_loaded_ = results_.size();
+            }
+        }
+        flock(fd, LOCK_UN);
+        close(fd);
+    }
+
+    std::string path_;
+    std::string configuration_;
+    std::unordered_map<Key, Value, BytewiseHash<Key>, BytewiseEqual<Key>> results_;
+    std::vector<Record> pending_;
+    size_t n_loaded_;
+    size_t n_hits_;
+    size_t n_stored_;
+};
+
+#endif
@@ -0,0 +1,538 @@
+#ifndef FRIEND_TREE_PRODUCER_SVFITPRODUCER_H
+#define FRIEND_TREE_PRODUCER_SVFITPRODUCER_H
+
+#include "TauAnalysis/ClassicSVfit/interface/ClassicSVfit.h"
+#include "TauAnalysis/ClassicSVfit/interface/MeasuredTauLepton.h"
+#include "TauAnalysis/ClassicSVfit/interface/SVfitIntegratorMarkovChain.h"
+#include "TauAnalysis/ClassicSVfit/interface/svFitHistogramAdapter.h"
+#include "TauAnalysis/ClassicSVfit/interface/FastMTT.h"
+
+#include "TH1F.h"
+#include "TROOT.h"
+#include "TVector2.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+#include "HiggsAnalysis/friend-tree-producer/interface/FriendProducer.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/HelperFunctions.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/Preselection.h"
+#include "HiggsAnalysis/friend-tree-producer/interface/ResultCache.h"
+
+using namespace classic_svFit;
+
+inline float folder_to_kappa_parameter(std::string foldername)
+{
+    std::string channel = folder_to_channel(foldername);
+    if(channel == "em" || channel == "ee" || channel == "mm") return 3.0;
+    else if(channel == "et") return 4.0;
+    else if(channel == "mt") return 4.0;
+    else if(channel == "tt") return 5.0;
+    else {std::cout << "Channel determined in a wrong way. Exiting"; exit(1);}
+    return -1.0;
+}
+
+inline std::pair<MeasuredTauLepton::kDecayType,MeasuredTauLepton::kDecayType> folder_to_ditaudecay(std::string foldername)
+{
+    std::string channel = folder_to_channel(foldername);
+    if(channel == "em")      return std::make_pair(MeasuredTauLepton::kTauToElecDecay,MeasuredTauLepton::kTauToMuDecay);
+    else if(channel == "ee") return std::make_pair(MeasuredTauLepton::kTauToElecDecay,MeasuredTauLepton::kTauToElecDecay);
+    else if(channel == "mm") return std::make_pair(MeasuredTauLepton::kTauToMuDecay,MeasuredTauLepton::kTauToMuDecay);
+    else if(channel == "et") return std::make_pair(MeasuredTauLepton::kTauToElecDecay,MeasuredTauLepton::kTauToHadDecay);
+    else if(channel == "mt") return std::make_pair(MeasuredTauLepton::kTauToMuDecay,MeasuredTauLepton::kTauToHadDecay);
+    else if(channel == "tt") return std::make_pair(MeasuredTauLepton::kTauToHadDecay,MeasuredTauLepton::kTauToHadDecay);
+    else {std::cout << "Channel determined in a wrong way. Exiting"; exit(1);}
+    return std::make_pair(MeasuredTauLepton::kUndefinedDecayType,MeasuredTauLepton::kUndefinedDecayType);
+}
+
+// Di-tau reconstruction algorithms of SVFitProducer
+enum class SVFitAlgorithm { ClassicSVfit, FastMTT };
+
+// Algorithm run on a MET definition with the branches <met_prefix>met, <met_prefix>metphi and <met_prefix>metcov00 to <met_prefix>metcov11.
+// The outputs are pt_<suffix>, eta_<suffix>, phi_<suffix> and m_<suffix> with the suffix sv for ClassicSVfit and fastmtt for FastMTT,
+// followed by _<met_prefix> for MET definitions other than the PF MET, e.g. m_fastmtt_puppi.
+struct SVFitComputation
+{
+    SVFitAlgorithm algorithm;
+    std::string met_prefix;
+
+    std::string algorithm_name() const { return algorithm == SVFitAlgorithm::ClassicSVfit ? "ClassicSVfit" : "FastMTT"; }
+    std::string suffix() const { return std::string(algorithm == SVFitAlgorithm::ClassicSVfit ? "sv" : "fastmtt") + (met_prefix != "" ? "_" + met_prefix : ""); }
+};
+
+// Parses a computation given as <algorithm>[:<met prefix>], with the algorithm sv or fastmtt, e.g. fastmtt:puppi
+inline SVFitComputation parse_svfit_computation(const std::string& text)
+{
+    const size_t separator = text.find(':');
+    const std::string algorithm = text.substr(0, separator);
+    SVFitComputation computation;
+    if(algorithm == "sv") computation.algorithm = SVFitAlgorithm::ClassicSVfit;
+    else if(algorithm == "fastmtt") computation.algorithm = SVFitAlgorithm::FastMTT;
+    else throw std::runtime_error("Unknown SVFit algorithm " + algorithm + " in " + text + ", expected sv or fastmtt.");
+    computation.met_prefix = separator == std::string::npos ? "" : text.substr(separator + 1);
+    return computation;
+}
+
+inline std::vector<SVFitComputation> parse_svfit_computations(const std::vector<std::string>& texts)
+{
+    std::vector<SVFitComputation> computations;
+    for(const auto& text : texts)
+    {
+        computations.push_back(parse_svfit_computation(text));
+        for(size_t c = 0; c + 1 < computations.size(); c++)
+        {
+            if(computations[c].suffix() == computations.back().suffix()) throw std::runtime_error("SVFit computation " + text + " is given twice.");
+        }
+    }
+    if(computations.size() == 0) throw std::runtime_error("No SVFit computation given.");
+    return computations;
+}
+
+// ClassicSVfit and FastMTT on the PF MET and the PUPPI MET
+inline std::vector<std::string> default_svfit_computations() { return {"sv", "sv:puppi", "fastmtt", "fastmtt:puppi"}; }
+
+// Accuracy/speed tier of the ClassicSVfit integration. The integration is run in stages, starting with initial_calls
+// evaluations of the likelihood and doubling them from stage to stage, as long as the calls of all stages stay within max_calls.
+// It stops early after a stage, whose mass differs by less than the relative tolerance from the mass of the previous stage.
+struct SVFitTier
+{
+    std::string name;
+    unsigned int initial_calls;
+    unsigned int max_calls;
+    double tolerance;
+
+    std::string configuration() const
+    {
+        std::stringstream configuration;
+        configuration << "initial_calls=" << initial_calls << ";max_calls=" << max_calls << ";tolerance=" << tolerance;
+        return configuration.str();
+    }
+};
+
+// The default tier is a single integration with the default number of likelihood calls of ClassicSVfit.
+// The staged tiers balanced and fast stop after two short integrations for most events, fastest is a single short integration
+// and precise repeats the integration with doubled calls until the mass is stable.
+inline const std::vector<SVFitTier>& svfit_tiers()
+{
+    static const std::vector<SVFitTier> tiers = {
+        {"default", 100000, 100000, 0.0},
+        {"balanced", 15000, 105000, 0.01},
+        {"fast", 5000, 35000, 0.02},
+        {"fastest", 10000, 10000, 0.0},
+        {"precise", 100000, 700000, 0.005},
+    };
+    return tiers;
+}
+
+inline SVFitTier svfit_tier(const std::string& name)
+{
+    std::string names;
+    for(const auto& tier : svfit_tiers())
+    {
+        if(tier.name == name) return tier;
+        names += (names != "" ? ", " : "") + tier.name;
+    }
+    throw std::runtime_error("Unknown SVFit tier " + name + ", expected one of " + names + ".");
+}
+
+// Inputs of ClassicSVFit or FastMTT for a single event and MET definition
+struct SVFitInputs
+{
+    Float_t pt_1,eta_1,phi_1,m_1;
+    Int_t decayMode_1;
+    Float_t pt_2,eta_2,phi_2,m_2;
+    Int_t decayMode_2;
+    Float_t met,metcov00,metcov01,metcov10,metcov11,metphi;
+};
+
+// Outputs of ClassicSVFit or FastMTT for a single event and MET definition
+struct SVFitResults
+{
+    Float_t pt,eta,phi,m;
+};
+
+// The inputs are compared and hashed bytewise, so the struct must not contain padding
+static_assert(sizeof(SVFitInputs) == 16 * 4, "SVFitInputs must be tightly packed");
+
+// Results of already computed input tuples, to be reused for identical events in other folders
+typedef std::unordered_map<SVFitInputs, SVFitResults, BytewiseHash<SVFitInputs>, BytewiseEqual<SVFitInputs>> SVFitMemo;
+
+// ClassicSVfit sets up its Markov chain integrator on the first integration, with Nint(calls / 100000) chains, i.e. none for
+// less than 50000 calls. set_calls() sets up the integrator for the given calls instead, with the settings of ClassicSVfit,
+// but at least one chain, such that short integrations run a single short chain.
+class StagedClassicSVfit : public ClassicSVfit
+{
+  public:
+    explicit StagedClassicSVfit(int verbosity = 0) : ClassicSVfit(verbosity), calls_(0) {}
+
+    void set_calls(unsigned int calls)
+    {
+        if(calls == calls_) return;
+        setMaxObjFunctionCalls(calls);
+        const unsigned int chains = std::max(1l, std::lround(calls / 100000.));
+        const unsigned int burnin = std::lround(0.10 * calls / chains);
+        delete intAlgo_;
+        intAlgo_ = new SVfitIntegratorMarkovChain("uniform", burnin, calls / chains, std::lround(0.20 * burnin), std::lround(0.60 * burnin),
+                                                  15., 1.0 - 1.e+2 / calls, chains, 1, 1.e-2, 0.71, "", verbosity_);
+        intAlgo_->registerCallBackFunction(*histogramAdapter_);
+        calls_ = calls;
+    }
+
+  private:
+    unsigned int calls_;
+};
+
+// Returns the number of likelihood calls of the ClassicSVfit integration, or 0 for FastMTT
+inline unsigned int compute_svfit(SVFitAlgorithm algorithm, StagedClassicSVfit& svFitAlgo, FastMTT& aFastMTTAlgo, const SVFitTier& tier,
+                                  const std::pair<MeasuredTauLepton::kDecayType,MeasuredTauLepton::kDecayType>& ditaudecay, const SVFitInputs& in, SVFitResults& out)
+{
+    // define MET;
+    TVector2 metVec;
+    metVec.SetMagPhi(in.met,in.metphi);
+
+    // define MET covariance
+    TMatrixD covMET(2, 2);
+    covMET[0][0] = in.metcov00;
+    covMET[1][0] = in.metcov10;
+    covMET[0][1] = in.metcov01;
+    covMET[1][1] = in.metcov11;
+
+    // determine the right mass convention for the TauLepton decay products
+    Float_t mass_1, mass_2;
+    if(ditaudecay.first == MeasuredTauLepton::kTauToElecDecay)        mass_1 = 0.51100e-3;
+    else if(ditaudecay.first == MeasuredTauLepton::kTauToElecDecay)   mass_1 = 105.658e-3;
+    else                                                              mass_1 = in.m_1;
+
+    if(ditaudecay.second == MeasuredTauLepton::kTauToElecDecay)       mass_2 = 0.51100e-3;
+    else if(ditaudecay.second == MeasuredTauLepton::kTauToElecDecay)  mass_2 = 105.658e-3;
+    else                                                              mass_2 = in.m_2;
+
+    // define lepton four vectors
+    std::vector<MeasuredTauLepton> measuredTauLeptons;
+    measuredTauLeptons.push_back(MeasuredTauLepton(ditaudecay.first, in.pt_1, in.eta_1, in.phi_1, mass_1, in.decayMode_1 >= 0 ? in.decayMode_1 : -1));
+    measuredTauLeptons.push_back(MeasuredTauLepton(ditaudecay.second,  in.pt_2, in.eta_2, in.phi_2, mass_2, in.decayMode_2 >= 0 ? in.decayMode_2 : -1));
+
+    /*
+       tauDecayModes:  0 one-prong without neutral pions
+                       1 one-prong with neutral pions
+          10 three-prong without neutral pions
+    */
+
+    if(algorithm == SVFitAlgorithm::ClassicSVfit)
+    {
+        // Run ClassicSVFit in stages of increasing number of likelihood calls, until the mass is stable or the calls of the tier are used up
+        unsigned int calls = tier.initial_calls;
+        unsigned int total_calls = 0;
+        Float_t previous_mass = default_float;
+        while(true)
+        {
+            svFitAlgo.set_calls(calls);
+            svFitAlgo.integrate(measuredTauLeptons, metVec.X(), metVec.Y(), covMET);
+            total_calls += calls;
+            bool isValidSolution = svFitAlgo.isValidSolution();
+
+            if ( isValidSolution ) {
+                out.pt = static_cast<DiTauSystemHistogramAdapter*>(svFitAlgo.getHistogramAdapter())->getPt();
+                out.eta = static_cast<DiTauSystemHistogramAdapter*>(svFitAlgo.getHistogramAdapter())->getEta();
+                out.phi = static_cast<DiTauSystemHistogramAdapter*>(svFitAlgo.getHistogramAdapter())->getPhi();
+                out.m = static_cast<DiTauSystemHistogramAdapter*>(svFitAlgo.getHistogramAdapter())->getMass();
+            } else {
+                out.pt = default_float;
+                out.eta = default_float;
+                out.phi = default_float;
+                out.m = default_float;
+                break;
+            }
+            if(previous_mass != default_float && std::fabs(out.m - previous_mass) < tier.tolerance * out.m) break;
+            if(total_calls + 2 * calls > tier.max_calls) break;
+            previous_mass = out.m;
+            calls *= 2;
+        }
+        return total_calls;
+    }
+    else
+    {
+        // Run FastMTT
+        aFastMTTAlgo.run(measuredTauLeptons,  metVec.X(), metVec.Y(), covMET);
+        LorentzVector ttP4 = aFastMTTAlgo.getBestP4();
+        out.pt = ttP4.Pt();
+        out.eta = ttP4.Eta();
+        out.phi = ttP4.Phi();
+        out.m = ttP4.M();
+        return 0;
+    }
+}
+
+// ClassicSVFit and FastMTT results for the di-tau system, computed on a given number of worker threads.
+// Only the selected computations, each an algorithm on a MET definition, are run, and only their output branches are created.
+// The results are kept per channel and algorithm for all tasks of the producer, such that events with
+// inputs unchanged by a shift, or with identical MET definitions, are integrated only once.
+// ClassicSVfit is integrated with the settings of the given tier, which are stored in the UserInfo of the friend tree.
+// Events failing the optional preselection are neither read nor computed and get default outputs.
+class SVFitProducer : public FriendProducer
+{
+  public:
+    SVFitProducer(unsigned int threads = 1, const std::string& cache_dir = "", const std::vector<std::string>& computations = default_svfit_computations(),
+                  const std::string& tier = "default", const std::string& preselection = "")
+        : threads_(std::max(1u, threads)), cache_dir_(cache_dir), computations_(parse_svfit_computations(computations)), tier_(svfit_tier(tier)), preselection_(preselection)
+    {
+        // ClassicSVFit creates ROOT histograms for each integration, which is only safe in parallel with thread-safety enabled
+        if(threads_ > 1)
+        {
+            ROOT::EnableThreadSafety();
+            TH1::AddDirectory(false);
+        }
+
+        // Initialize one ClassicSVFit and FastMTT instance per worker thread.
+        // ClassicSVFit re-seeds its Markov chain for each integration, such that the results
+        // do not depend on which worker processed which events before.
+        for(unsigned int t = 0; t < threads_; t++)
+        {
+            svFitAlgos_.emplace_back(new StagedClassicSVfit(0));
+            aFastMTTAlgos_.emplace_back(new FastMTT());
+        }
+    }
+
+    std::string name() const override { return "SVFit"; }
+    std::string title() const override { return "svfit friend tree"; }
+
+    std::map<std::string, std::string> metadata() const override
+    {
+        std::stringstream tolerance;
+        tolerance << tier_.tolerance;
+        std::map<std::string, std::string> metadata = {{"svfit_tier", tier_.name},
+                                                       {"svfit_initial_calls", std::to_string(tier_.initial_calls)},
+                                                       {"svfit_max_calls", std::to_string(tier_.max_calls)},
+                                                       {"svfit_tolerance", tolerance.str()}};
+        if(preselection_.enabled()) metadata["preselection"] = preselection_.expression();
+        return metadata;
+    }
+
+    void declare(const ProducerTask& task, InputSchema& inputs, OutputSchema& outputs) override
+    {
+        folder_ = task.folder;
+
+        // Branches of the preselection, read first to select the events to be computed.
+        // All other quantities are read only for the selected events.
+        preselection_.declare(inputs);
+
+        // Quantities of first lepton
+        pt_1_ = inputs.add_selected<Float_t>("pt_1");
+        eta_1_ = inputs.add_selected<Float_t>("eta_1");
+        phi_1_ = inputs.add_selected<Float_t>("phi_1");
+        m_1_ = inputs.add_selected<Float_t>("m_1");
+        decayMode_1_ = inputs.add_selected<Int_t>("decayMode_1");
+
+        // Quantities of second lepton
+        pt_2_ = inputs.add_selected<Float_t>("pt_2");
+        eta_2_ = inputs.add_selected<Float_t>("eta_2");
+        phi_2_ = inputs.add_selected<Float_t>("phi_2");
+        m_2_ = inputs.add_selected<Float_t>("m_2");
+        decayMode_2_ = inputs.add_selected<Int_t>("decayMode_2");
+
+        // Quantities of the MET definition of each computation, in the order of SVFitInputs, and its outputs, in the order of SVFitResults
+        met_.clear();
+        outputs_.clear();
+        for(const auto& computation : computations_)
+        {
+            met_.emplace_back();
+            for(const auto& quantity : {"met", "metcov00", "metcov01", "metcov10", "metcov11", "metphi"}) met_.back().push_back(inputs.add_selected<Float_t>(computation.met_prefix + quantity));
+            outputs_.emplace_back();
+            for(const auto& quantity : {"pt_", "eta_", "phi_", "m_"}) outputs_.back().push_back(outputs.add(quantity + computation.suffix()));
+        }
+
+        // Initialize SVFit settings
+        float kappa_parameter = folder_to_kappa_parameter(task.folder); // fully-leptonic: 3.0, semi-leptonic: 4.0; fully-hadronic: 5.0
+        ditaudecay_ = folder_to_ditaudecay(task.folder);
+        for(auto& svFitAlgo : svFitAlgos_) svFitAlgo->addLogM_fixed(true, kappa_parameter);
+        std::string channel = folder_to_channel(task.folder);
+        // Shifted folders repeat the inputs of the same events only within one input file.
+        // The results and cache files of previous files are dropped, such that a process handling many tasks keeps its memory.
+        if(task.input != input_)
+        {
+            memos_.clear();
+            caches_.clear();
+        }
+        input_ = task.input;
+        memo_.clear();
+        cache_.clear();
+        for(const auto& computation : computations_)
+        {
+            // The results do not depend on the MET definition, such that all computations of an algorithm share their results
+            const std::string algorithm = computation.algorithm_name();
+            const std::string key = channel + ";" + algorithm;
+            if(caches_.find(key) == caches_.end())
+            {
+                std::stringstream cache_configuration;
+                cache_configuration << algorithm << ";channel=" << channel << ";kappa=" << kappa_parameter << ";decays=" << ditaudecay_.first << "," << ditaudecay_.second;
+                if(computation.algorithm == SVFitAlgorithm::ClassicSVfit) cache_configuration << ";" << tier_.configuration();
+                caches_[key].reset(new ResultCache<SVFitInputs, SVFitResults>(cache_dir_, "SVFit", cache_sample(task.input), cache_configuration.str()));
+            }
+            memo_.push_back(&memos_[key]);
+            cache_.push_back(caches_[key].get());
+        }
+        n_computed_ = 0;
+        n_reused_ = 0;
+        n_integrations_ = 0;
+        n_calls_ = 0;
+    }
+
+    void select(const InputBlock& inputs, std::vector<bool>& selected) const override { preselection_.evaluate(inputs, selected); }
+
+    // Compute the outputs of not yet known input tuples of the block on the worker threads
+    void compute(const InputBlock& inputs, const std::vector<bool>& selected, OutputBlock& outputs) override
+    {
+        for(size_t k = 0; k < inputs.size(); k++) preselection_.count(selected[k]);
+        block_inputs_.resize(computations_.size());
+        block_todo_.clear();
+        for(size_t c = 0; c < computations_.size(); c++)
+        {
+            std::vector<const std::vector<Float_t>*> met;
+            for(const auto& column : met_[c]) met.push_back(&inputs.get(column));
+            block_inputs_[c].resize(inputs.size());
+            for(size_t k = 0; k < inputs.size(); k++)
+            {
+                if(!selected[k]) continue;
+                SVFitInputs& event_inputs = block_inputs_[c][k];
+                event_inputs = {inputs.get(pt_1_)[k], inputs.get(eta_1_)[k], inputs.get(phi_1_)[k], inputs.get(m_1_)[k], inputs.get(decayMode_1_)[k],
+                                inputs.get(pt_2_)[k], inputs.get(eta_2_)[k], inputs.get(phi_2_)[k], inputs.get(m_2_)[k], inputs.get(decayMode_2_)[k],
+                                (*met[0])[k], (*met[1])[k], (*met[2])[k], (*met[3])[k], (*met[4])[k], (*met[5])[k]};
+                if(memo_[c]->find(event_inputs) == memo_[c]->end())
+                {
+                    // Reserve the entry, such that duplicates within the block are computed only once
+                    SVFitResults& cached_results = (*memo_[c])[event_inputs];
+                    if(!cache_[c]->get(event_inputs, cached_results)) block_todo_.push_back(std::make_pair(c, event_inputs));
+                }
+            }
+            n_reused_ += std::count(selected.begin(), selected.end(), true);
+        }
+        block_results_.resize(block_todo_.size());
+        block_calls_.assign(block_todo_.size(), 0);
+        n_computed_ += block_todo_.size();
+        n_reused_ -= block_todo_.size();
+
+        if(threads_ == 1)
+        {
+            for(size_t k = 0; k < block_todo_.size(); k++)
+            {
+                block_calls_[k] = compute_svfit(computations_[block_todo_[k].first].algorithm, *svFitAlgos_[0], *aFastMTTAlgos_[0], tier_, ditaudecay_, block_todo_[k].second, block_results_[k]);
+            }
+        }
+        else
+        {
+            // Workers take small ranges of events one after another to balance the load
+            const size_t chunk_size = std::max<size_t>(1, block_todo_.size() / (4 * threads_));
+            std::atomic<size_t> next_event(0);
+            std::vector<std::thread> workers;
+            for(unsigned int t = 0; t < threads_; t++)
+            {
+                workers.emplace_back([&, t]()
+                {
+                    for(size_t chunk_first = next_event.fetch_add(chunk_size); chunk_first < block_todo_.size(); chunk_first = next_event.fetch_add(chunk_size))
+                    {
+                        const size_t chunk_last = std::min(block_todo_.size(), chunk_first + chunk_size);
+                        for(size_t k = chunk_first; k < chunk_last; k++)
+                        {
+                            block_calls_[k] = compute_svfit(computations_[block_todo_[k].first].algorithm, *svFitAlgos_[t], *aFastMTTAlgos_[t], tier_, ditaudecay_, block_todo_[k].second, block_results_[k]);
+                        }
+                    }
+                });
+            }
+            for(auto& worker : workers) worker.join();
+        }
+        for(size_t k = 0; k < block_todo_.size(); k++)
+        {
+            const size_t c = block_todo_[k].first;
+            (*memo_[c])[block_todo_[k].second] = block_results_[k];
+            cache_[c]->put(block_todo_[k].second, block_results_[k]);
+            if(computations_[c].algorithm == SVFitAlgorithm::ClassicSVfit)
+            {
+                n_integrations_++;
+                n_calls_ += block_calls_[k];
+            }
+        }
+        for(auto cache : cache_) cache->flush();
+
+        // Set outputs in entry order
+        for(size_t c = 0; c < computations_.size(); c++)
+        {
+            for(size_t k = 0; k < block_inputs_[c].size(); k++)
+            {
+                if(!selected[k])
+                {
+                    for(const auto& output : outputs_[c]) outputs.set(output, k, default_float);
+                    continue;
+                }
+                const SVFitResults& event_results = (*memo_[c])[block_inputs_[c][k]];
+                const Float_t* values = &event_results.pt;
+                for(size_t index = 0; index < outputs_[c].size(); index++) outputs.set(outputs_[c][index], k, values[index]);
+            }
+        }
+    }
+
+    void finish() override
+    {
+        if(preselection_.enabled()) std::cout << folder_ << ": " << preselection_.summary() << std::endl;
+        std::cout << folder_ << ": computed " << n_computed_ << " results, reused " << n_reused_ << " results" << std::endl;
+        if(n_integrations_ > 0)
+        {
+            std::cout << folder_ << ": ClassicSVfit tier " << tier_.name << " with " << double(n_calls_) / n_integrations_ << " likelihood calls per integration on average" << std::endl;
+        }
+        for(size_t c = 0; c < cache_.size(); c++)
+        {
+            // Computations of the same algorithm share their cache
+            if(cache_[c]->enabled() && std::find(cache_.begin(), cache_.begin() + c, cache_[c]) == cache_.begin() + c) std::cout << folder_ << ": " << cache_[c]->summary() << std::endl;
+        }
+    }
+
+  private:
+    unsigned int threads_;
+    std::string cache_dir_;
+    std::vector<SVFitComputation> computations_;
+    SVFitTier tier_;
+    Preselection preselection_;
+    std::vector<std::unique_ptr<StagedClassicSVfit>> svFitAlgos_;
+    std::vector<std::unique_ptr<FastMTT>> aFastMTTAlgos_;
+
+    // Settings and statistics of the current task
+    std::string input_;
+    std::string folder_;
+    std::pair<MeasuredTauLepton::kDecayType,MeasuredTauLepton::kDecayType> ditaudecay_;
+    unsigned int n_computed_ = 0;
+    unsigned int n_reused_ = 0;
+    unsigned int n_integrations_ = 0;
+    unsigned long n_calls_ = 0;
+
+    // Results per channel and algorithm, shared by all folders of the input file. The channel determines the SVFit settings,
+    // such that identical input tuples within the same channel lead to identical results.
+    std::map<std::string, SVFitMemo> memos_;
+    std::vector<SVFitMemo*> memo_;
+
+    // Persistent results from previous jobs on the sample of the input file per channel and algorithm, in case a cache directory is given
+    std::map<std::string, std::unique_ptr<ResultCache<SVFitInputs, SVFitResults>>> caches_;
+    std::vector<ResultCache<SVFitInputs, SVFitResults>*> cache_;
+
+    InputColumn<Float_t> pt_1_, eta_1_, phi_1_, m_1_, pt_2_, eta_2_, phi_2_, m_2_;
+    InputColumn<Int_t> decayMode_1_, decayMode_2_;
+    std::vector<std::vector<InputColumn<Float_t>>> met_;
+    std::vector<std::vector<OutputColumn>> outputs_;
+
+    // Inputs of each computation, and the inputs to be computed together with the index of their computation
+    std::vector<std::vector<SVFitInputs>> block_inputs_;
+    std::vector<std::pair<size_t, SVFitInputs>> block_todo_;
+    std::vector<SVFitResults> block_results_;
+    std::vector<unsigned int> block_calls_;
+};
+
+// The results are set as consecutive Float_t values
+static_assert(sizeof(SVFitResults) == 4 * sizeof(Float_t), "SVFitResults must be tightly packed");
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef FRIEND_TREE_PRODUCER_SIMDKERNELS_H
+#define FRIEND_TREE_PRODUCER_SIMDKERNELS_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Kernels of the reduced-precision network evaluation. The values of a layer are stored with one row per
+// feature and the events of a block contiguous within each row, such that the loops over the events vectorize.
+// Each kernel is compiled for AVX-512, AVX2 and the baseline instruction set, and the variant matching the features
+// of the CPU is selected when the executable is loaded. The kernels are optimized with -O3, since the vectorizer
+// of -O2 gives up on the loops over the events with their unknown trip count.
+#define FRIEND_TREE_PRODUCER_SIMD_KERNEL __attribute__((target_clones("avx512f", "avx2", "default"), optimize("O3")))
+
+// Widest instruction set used by the kernels on this CPU
+inline std::string simd_instruction_set()
+{
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f")) return "AVX-512";
+    if(__builtin_cpu_supports("avx2")) return "AVX2";
+    return "baseline";
+}
+
+// Dense layer in single precision with the weights stored row-wise, one row per output
+FRIEND_TREE_PRODUCER_SIMD_KERNEL
+inline void dense_float(const float* __restrict weights, const float* __restrict bias, size_t n_inputs, size_t n_outputs, const float* __restrict inputs,
+                        float* __restrict outputs, size_t n_events)
+{
+    for(size_t o = 0; o < n_outputs; o++)
+    {
+        float* __restrict output = outputs + o * n_events;
+        for(size_t k = 0; k < n_events; k++) output[k] = bias[o];
+        for(size_t i = 0; i < n_inputs; i++)
+        {
+            const float weight = weights[o * n_inputs + i];
+            const float* __restrict input = inputs + i * n_events;
+            for(size_t k = 0; k < n_events; k++) output[k] += weight * input[k];
+        }
+    }
+}
+
+FRIEND_TREE_PRODUCER_SIMD_KERNEL
+inline void normalization_float(const float* __restrict weights, const float* __restrict bias, size_t n_rows, float* __restrict values, size_t n_events)
+{
+    for(size_t r = 0; r < n_rows; r++)
+    {
+        float* __restrict row = values + r * n_events;
+        for(size_t k = 0; k < n_events; k++) row[k] = (row[k] + bias[r]) * weights[r];
+    }
+}
+
+// Symmetric quantization of the values of each event to int8, with the scale of each event chosen
+// such that its largest absolute value is mapped to 127
+FRIEND_TREE_PRODUCER_SIMD_KERNEL
+inline void quantize_int8(const float* __restrict values, size_t n_rows, size_t n_events, int8_t* __restrict quantized, float* __restrict scales)
+{
+    for(size_t k = 0; k < n_events; k++) scales[k] = 0.0f;
+    for(size_t r = 0; r < n_rows; r++)
+    {
+        const float* __restrict row = values + r * n_events;
+        for(size_t k = 0; k < n_events; k++) scales[k] = std::max(scales[k], std::fabs(row[k]));
+    }
+    for(size_t k = 0; k < n_events; k++) scales[k] = scales[k] > 0.0f ? scales[k] / 127.0f : 1.0f;
+    for(size_t r = 0; r < n_rows; r++)
+    {
+        const float* __restrict row = values + r * n_events;
+        int8_t* __restrict quantized_row = quantized + r * n_events;
+        for(size_t k = 0; k < n_events; k++)
+        {
+            const float value = row[k] / scales[k];
+            quantized_row[k] = static_cast<int8_t>(static_cast<int32_t>(value + (value >= 0.0f ? 0.5f : -0.5f)));
+        }
+    }
+}
+
+// Dense layer on int8 inputs and weights, accumulated in int32. The weights are quantized per output row,
+// and the result is scaled back to single precision with the scales of the weights and of the inputs.
+FRIEND_TREE_PRODUCER_SIMD_KERNEL
+inline void dense_int8(const int8_t* __restrict weights, const float* __restrict weight_scales, const float* __restrict bias, size_t n_inputs, size_t n_outputs,
+                       const int8_t* __restrict inputs, const float* __restrict input_scales, int32_t* __restrict accumulator, float* __restrict outputs, size_t n_events)
+{
+    for(size_t o = 0; o < n_outputs; o++)
+    {
+        for(size_t k = 0; k < n_events; k++) accumulator[k] = 0;
+        for(size_t i = 0; i < n_inputs; i++)
+        {
+            const int32_t weight = weights[o * n_inputs + i];
+            const int8_t* __restrict input = inputs + i * n_events;
+            for(size_t k = 0; k < n_events; k++) accumulator[k] += weight * static_cast<int32_t>(input[k]);
+        }
+        float* __restrict output = outputs + o * n_events;
+        const float weight_scale = weight_scales[o];
+        for(size_t k = 0; k < n_events; k++) output[k] = bias[o] + weight_scale * input_scales[k] * static_cast<float>(accumulator[k]);
+    }
+}
+
+#endif
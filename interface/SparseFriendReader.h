@@ -0,0 +1,131 @@
+#ifndef FRIEND_TREE_PRODUCER_SPARSEFRIENDREADER_H
+#define FRIEND_TREE_PRODUCER_SPARSEFRIENDREADER_H
+
+#include "TBranch.h"
+#include "TFile.h"
+#include "TObjArray.h"
+#include "TTree.h"
+
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Reader of a friend tree written with --sparse_output, to be used alongside the input tree like a friend.
+// After load() with the entry number of the input tree, or with its run and event number, the values of the
+// friend branches are available through their addresses, with default values for entries without row.
+//
+//     SparseFriendReader mela("MELA/<input>.root", "mt_nominal");
+//     const Float_t* ME_vbf = mela.address("ME_vbf");
+//     for(Long64_t entry = 0; entry < input->GetEntries(); entry++)
+//     {
+//         input->GetEntry(entry);
+//         mela.load(entry);
+//         ... *ME_vbf ...
+//     }
+class SparseFriendReader
+{
+  public:
+    SparseFriendReader(const std::string& filename, const std::string& folder, const std::string& tree = "ntuple", Float_t default_value = -10.f)
+        : default_value_(default_value)
+    {
+        file_ = TFile::Open(filename.c_str(), "read");
+        if(!file_ || file_->IsZombie()) throw std::runtime_error("Could not open " + filename + ".");
+        tree_ = (TTree*) file_->Get((folder + "/" + tree).c_str());
+        if(!tree_) throw std::runtime_error("Tree " + folder + "/" + tree + " not found in " + filename + ".");
+        TBranch* entry_branch = tree_->GetBranch("entry");
+        if(!entry_branch) throw std::runtime_error("Friend tree " + folder + "/" + tree + " of " + filename + " is not a sparse output.");
+
+        // Values of all friend branches, besides the index branches
+        TObjArray* branch_list = tree_->GetListOfBranches();
+        for(int b = 0; b < branch_list->GetEntries(); b++)
+        {
+            const std::string name = branch_list->At(b)->GetName();
+            if(name != "entry" && name != "run" && name != "lumi" && name != "event") branches_.push_back(name);
+        }
+        values_.assign(branches_.size(), default_value_);
+        for(size_t index = 0; index < branches_.size(); index++)
+        {
+            tree_->SetBranchAddress(branches_[index].c_str(), &values_[index]);
+            indices_[branches_[index]] = index;
+        }
+
+        // Rows by entry number of the input tree, read from the entry branch only
+        Long64_t entry = 0;
+        entry_branch->SetAddress(&entry);
+        rows_.reserve(tree_->GetEntries());
+        for(Long64_t row = 0; row < tree_->GetEntries(); row++)
+        {
+            entry_branch->GetEntry(row);
+            rows_.emplace_back(entry, row);
+        }
+        // The local entry must not stay bound to the branch
+        entry_branch->ResetAddress();
+        std::sort(rows_.begin(), rows_.end());
+        tree_->SetBranchStatus("entry", 0);
+    }
+
+    ~SparseFriendReader()
+    {
+        file_->Close();
+        delete file_;
+    }
+
+    SparseFriendReader(const SparseFriendReader&) = delete;
+    SparseFriendReader& operator=(const SparseFriendReader&) = delete;
+
+    const std::vector<std::string>& branches() const { return branches_; }
+
+    // Address of the value of a branch, valid for the lifetime of the reader
+    const Float_t* address(const std::string& branch) const
+    {
+        auto index = indices_.find(branch);
+        if(index == indices_.end()) throw std::runtime_error("Branch " + branch + " not found in sparse friend tree.");
+        return &values_[index->second];
+    }
+
+    Float_t value(const std::string& branch) const { return *address(branch); }
+
+    // Loads the row of an entry of the input tree. Returns false and sets all values to the default, if the entry has no row.
+    bool load(Long64_t entry)
+    {
+        auto row = std::lower_bound(rows_.begin(), rows_.end(), std::make_pair(entry, Long64_t(0)));
+        return load_row(row != rows_.end() && row->first == entry ? row->second : -1);
+    }
+
+    // Loads the row with the given run and event number, e.g. for input trees with a different order of the events
+    bool load(UInt_t run, ULong64_t event)
+    {
+        if(rows_.size() == 0) return load_row(-1);
+        if(!tree_->GetTreeIndex()) tree_->BuildIndex("run", "event");
+        return load_row(tree_->GetEntryNumberWithIndex(run, event));
+    }
+
+    // Number of rows, i.e. of computed entries
+    size_t rows() const { return rows_.size(); }
+
+  private:
+    bool load_row(Long64_t row)
+    {
+        if(row < 0)
+        {
+            std::fill(values_.begin(), values_.end(), default_value_);
+            return false;
+        }
+        tree_->GetEntry(row);
+        return true;
+    }
+
+    Float_t default_value_;
+    TFile* file_;
+    TTree* tree_;
+    std::vector<std::string> branches_;
+    std::map<std::string, size_t> indices_;
+    std::vector<Float_t> values_;
+    // Pairs of entry number in the input tree and row in the friend tree, sorted by entry number
+    std::vector<std::pair<Long64_t, Long64_t>> rows_;
+};
+
+#endif
@@ -0,0 +1,240 @@
+#ifndef FRIEND_TREE_PRODUCER_SYNTHETICNTUPLE_H
+#define FRIEND_TREE_PRODUCER_SYNTHETICNTUPLE_H
+
+#include "TFile.h"
+#include "TLorentzVector.h"
+#include "TTree.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "HiggsAnalysis/friend-tree-producer/interface/HelperFunctions.h"
+
+// Writes ntuples with random events in the branch layout of the synchronization ntuples read by the producers.
+//
+// The file <output_dir>/<nick>/<nick>.root contains one folder <channel>_nominal with the tree ntuple per channel.
+// The distributions roughly follow the ones of selected Z -> tautau events: lepton pt above the trigger thresholds,
+// the decay mode fractions of hadronic taus, about 17 % of the events with at least two jets, pileup and MET resolution.
+class SyntheticNtuple
+{
+  public:
+    SyntheticNtuple(unsigned int seed, const std::vector<std::string>& extra_branches = {}) : generator_(seed), extra_branches_(extra_branches)
+    {
+    }
+
+    // Returns the path of the written file
+    std::string write(const std::string& output_dir, const std::string& nick, const std::vector<std::string>& channels, unsigned int events)
+    {
+        boost::filesystem::path outputpath = boost::filesystem::path(output_dir) / nick / (nick + ".root");
+        boost::filesystem::create_directories(outputpath.parent_path());
+        TFile* file = TFile::Open(outputpath.string().c_str(), "recreate");
+        if(!file || file->IsZombie()) throw std::runtime_error("Could not create " + outputpath.string() + ".");
+        ULong64_t event = 0;
+        for(const auto& channel : channels)
+        {
+            const std::string folder = channel + "_nominal";
+            file->mkdir(folder.c_str());
+            file->cd(folder.c_str());
+            TTree* tree = new TTree("ntuple", "ntuple");
+            book(tree);
+            for(unsigned int n = 0; n < events; n++)
+            {
+                event_ = ++event;
+                run_ = 1;
+                lumi_ = 1 + event / 1000;
+                generate(channel);
+                tree->Fill();
+            }
+            tree->Write("", TObject::kOverwrite);
+        }
+        file->Close();
+        delete file;
+        return outputpath.string();
+    }
+
+    // Writes <output_dir>/datasets.json with the year of the nick, as needed by NNScore and the correction weights.
+    // Returns the path of the written file.
+    static std::string write_datasets(const std::string& output_dir, const std::string& nick, int year)
+    {
+        boost::property_tree::ptree datasets_json;
+        datasets_json.put(nick + ".year", year);
+        boost::filesystem::create_directories(output_dir);
+        std::string datasets = (boost::filesystem::path(output_dir) / "datasets.json").string();
+        boost::property_tree::json_parser::write_json(datasets, datasets_json);
+        return datasets;
+    }
+
+  private:
+    void book(TTree* tree)
+    {
+        floats_.clear();
+        ints_.clear();
+        std::vector<std::string> float_branches = {"pt_1", "eta_1", "phi_1", "m_1", "q_1", "ptcharged_1", "phicharged_1",
+                                                   "pt_2", "eta_2", "phi_2", "m_2", "q_2", "ptcharged_2", "phicharged_2",
+                                                   "jpt_1", "jeta_1", "jphi_1", "jpt_2", "jeta_2", "jphi_2", "mjj", "jdeta",
+                                                   "m_vis", "pt_vis", "genbosonmass", "genbosonpt",
+                                                   "metcov00", "metcov01", "metcov10", "metcov11",
+                                                   "puppimetcov00", "puppimetcov01", "puppimetcov10", "puppimetcov11"};
+        for(const auto& met_definition : met_definitions())
+        {
+            for(const auto& quantity : {"met", "metphi", "metsumet"}) float_branches.push_back(met_definition + quantity);
+        }
+        float_branches.insert(float_branches.end(), extra_branches_.begin(), extra_branches_.end());
+        for(const auto& branch : float_branches)
+        {
+            if(floats_.count(branch) > 0) continue;
+            tree->Branch(branch.c_str(), &floats_[branch], (branch + "/F").c_str());
+        }
+        for(const auto& branch : {"njets", "nbtag", "npv", "decayMode_1", "decayMode_2"})
+        {
+            tree->Branch(branch, &ints_[branch], (std::string(branch) + "/I").c_str());
+        }
+        tree->Branch("event", &event_, "event/l");
+        tree->Branch("run", &run_, "run/i");
+        tree->Branch("lumi", &lumi_, "lumi/i");
+    }
+
+    static std::vector<std::string> met_definitions() { return {"", "track", "nopu", "pucor", "pu", "puppi"}; }
+
+    void generate(const std::string& channel)
+    {
+        if(channel == "et") generate_leptons('e', 't');
+        else if(channel == "mt") generate_leptons('m', 't');
+        else if(channel == "tt") generate_leptons('t', 't');
+        else if(channel == "em") generate_leptons('e', 'm');
+        else throw std::runtime_error("Channel " + channel + " not available for synthetic ntuples.");
+        generate_jets();
+        generate_met();
+
+        // Generator boson: mostly on the Z peak, with a low mass tail
+        if(uniform(0.0, 1.0) < 0.85) floats_["genbosonmass"] = std::max(0.5, 91.19 + 1.25 * std::tan(M_PI * (uniform(0.0, 1.0) - 0.5)));
+        else floats_["genbosonmass"] = 20.0 + exponential(40.0);
+        floats_["genbosonpt"] = exponential(25.0);
+
+        for(const auto& branch : extra_branches_) floats_[branch] = exponential(50.0);
+    }
+
+    void generate_leptons(char flavour_1, char flavour_2)
+    {
+        TLorentzVector lepton_1 = generate_lepton(flavour_1, flavour_2 == 't' && flavour_1 == 't', "1");
+        TLorentzVector lepton_2 = generate_lepton(flavour_2, flavour_2 == 't' && flavour_1 == 't', "2");
+        floats_["q_1"] = uniform(0.0, 1.0) < 0.5 ? 1.0 : -1.0;
+        floats_["q_2"] = uniform(0.0, 1.0) < 0.9 ? -floats_["q_1"] : floats_["q_1"];
+        floats_["m_vis"] = (lepton_1 + lepton_2).M();
+        floats_["pt_vis"] = (lepton_1 + lepton_2).Pt();
+    }
+
+    TLorentzVector generate_lepton(char flavour, bool ditau_trigger, const std::string& index)
+    {
+        Float_t pt, eta, mass;
+        Int_t decay_mode = -1;
+        if(flavour == 'e')
+        {
+            pt = 26.0 + exponential(20.0);
+            eta = uniform(-2.1, 2.1);
+            mass = 0.000511;
+        }
+        else if(flavour == 'm')
+        {
+            pt = 23.0 + exponential(20.0);
+            eta = uniform(-2.1, 2.1);
+            mass = 0.10566;
+        }
+        else
+        {
+            pt = (ditau_trigger ? 40.0 : 30.0) + exponential(25.0);
+            eta = uniform(-2.3, 2.3);
+            const double decay = uniform(0.0, 1.0);
+            decay_mode = decay < 0.25 ? 0 : (decay < 0.75 ? 1 : (decay < 0.95 ? 10 : 11));
+            mass = decay_mode == 0 ? 0.13957 : std::min(1.7, std::max(0.3, normal(0.9, 0.25)));
+        }
+        const Float_t phi = uniform(-M_PI, M_PI);
+        floats_["pt_" + index] = pt;
+        floats_["eta_" + index] = eta;
+        floats_["phi_" + index] = phi;
+        floats_["m_" + index] = mass;
+        floats_["ptcharged_" + index] = flavour == 't' ? pt * uniform(0.4, 1.0) : pt;
+        floats_["phicharged_" + index] = phi + normal(0.0, 0.01);
+        ints_["decayMode_" + index] = decay_mode;
+
+        TLorentzVector lepton;
+        lepton.SetPtEtaPhiM(pt, eta, phi, mass);
+        return lepton;
+    }
+
+    void generate_jets()
+    {
+        const double multiplicity = uniform(0.0, 1.0);
+        const Int_t njets = multiplicity < 0.55 ? 0 : (multiplicity < 0.83 ? 1 : (multiplicity < 0.94 ? 2 : (multiplicity < 0.98 ? 3 : 4)));
+        ints_["njets"] = njets;
+        const double btags = uniform(0.0, 1.0);
+        ints_["nbtag"] = std::min(njets, btags < 0.85 ? 0 : (btags < 0.97 ? 1 : 2));
+
+        std::vector<TLorentzVector> jets;
+        std::vector<Float_t> pts;
+        for(Int_t n = 0; n < std::min(njets, 2); n++) pts.push_back(30.0 + exponential(n == 0 ? 50.0 : 25.0));
+        std::sort(pts.begin(), pts.end(), std::greater<Float_t>());
+        for(size_t n = 0; n < 2; n++)
+        {
+            const std::string index = std::to_string(n + 1);
+            if(n < pts.size())
+            {
+                floats_["jpt_" + index] = pts[n];
+                floats_["jeta_" + index] = uniform(-4.7, 4.7);
+                floats_["jphi_" + index] = uniform(-M_PI, M_PI);
+                jets.emplace_back();
+                jets.back().SetPtEtaPhiM(pts[n], floats_["jeta_" + index], floats_["jphi_" + index], 0.0);
+            }
+            else
+            {
+                floats_["jpt_" + index] = default_float;
+                floats_["jeta_" + index] = default_float;
+                floats_["jphi_" + index] = default_float;
+            }
+        }
+        floats_["mjj"] = jets.size() == 2 ? (jets[0] + jets[1]).M() : default_float;
+        floats_["jdeta"] = jets.size() == 2 ? std::abs(floats_["jeta_1"] - floats_["jeta_2"]) : default_float;
+    }
+
+    void generate_met()
+    {
+        std::poisson_distribution<Int_t> npv(30.0);
+        ints_["npv"] = npv(generator_);
+        for(const auto& met_definition : met_definitions())
+        {
+            floats_[met_definition + "met"] = exponential(35.0);
+            floats_[met_definition + "metphi"] = uniform(-M_PI, M_PI);
+            floats_[met_definition + "metsumet"] = 300.0 + exponential(600.0);
+        }
+        for(const std::string met_definition : {"", "puppi"})
+        {
+            floats_[met_definition + "metcov00"] = uniform(200.0, 800.0);
+            floats_[met_definition + "metcov11"] = uniform(200.0, 800.0);
+            floats_[met_definition + "metcov01"] = uniform(-100.0, 100.0);
+            floats_[met_definition + "metcov10"] = floats_[met_definition + "metcov01"];
+        }
+    }
+
+    double uniform(double min, double max) { return std::uniform_real_distribution<double>(min, max)(generator_); }
+    double exponential(double mean) { return std::exponential_distribution<double>(1.0 / mean)(generator_); }
+    double normal(double mean, double sigma) { return std::normal_distribution<double>(mean, sigma)(generator_); }
+
+    std::mt19937_64 generator_;
+    std::vector<std::string> extra_branches_;
+    std::map<std::string, Float_t> floats_;
+    std::map<std::string, Int_t> ints_;
+    ULong64_t event_;
+    UInt_t run_, lumi_;
+};
+
+#endif
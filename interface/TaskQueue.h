@@ -0,0 +1,183 @@
+#ifndef FRIEND_TREE_PRODUCER_TASKQUEUE_H
+#define FRIEND_TREE_PRODUCER_TASKQUEUE_H
+
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "HiggsAnalysis/friend-tree-producer/interface/FriendTreeRunner.h"
+
+// Settings to process many tasks within one process, such that the producers are set up once
+// and their models and histograms are reused for all tasks. The tasks are read either from a task file,
+// or from a spool directory, in which *.task files are claimed by the processes watching it.
+struct TaskQueueSettings
+{
+    std::string task_file = "";
+    std::string spool_dir = "";
+    // Seconds to wait for new task files in the spool directory, before the process stops
+    unsigned int idle_timeout = 60;
+    // Input files kept open for further tasks
+    unsigned int open_files = 4;
+
+    bool enabled() const { return task_file != "" || spool_dir != ""; }
+};
+
+inline void add_task_queue_options(boost::program_options::options_description& config, TaskQueueSettings& settings)
+{
+    namespace po = boost::program_options;
+    config.add_options()
+        ("task_file", po::value<std::string>(&settings.task_file)->default_value(settings.task_file), "file with one task per line: <input> <folder> <first_entry> <last_entry> [<input_friend> ...]")
+        ("spool_dir", po::value<std::string>(&settings.spool_dir)->default_value(settings.spool_dir), "directory with *.task files in the format of --task_file, processed until a STOP file appears or no task arrives within --idle_timeout")
+        ("idle_timeout", po::value<unsigned int>(&settings.idle_timeout)->default_value(settings.idle_timeout))
+        ("open_files", po::value<unsigned int>(&settings.open_files)->default_value(settings.open_files));
+}
+
+// Reads the tasks of a task file. Empty lines and lines starting with # are skipped.
+inline std::vector<ProducerTask> read_tasks(const std::string& task_file, const std::string& tree)
+{
+    std::ifstream file(task_file);
+    if(!file) throw std::runtime_error("Could not read task file " + task_file + ".");
+    std::vector<ProducerTask> tasks;
+    std::string line;
+    while(std::getline(file, line))
+    {
+        std::stringstream fields(line);
+        ProducerTask task;
+        task.tree = tree;
+        if(!(fields >> task.input) || task.input[0] == '#') continue;
+        if(!(fields >> task.folder >> task.first_entry >> task.last_entry) || task.first_entry > task.last_entry)
+        {
+            throw std::runtime_error("Invalid task in " + task_file + ": " + line);
+        }
+        std::string input_friend;
+        while(fields >> input_friend) task.input_friends.push_back(input_friend);
+        tasks.push_back(task);
+    }
+    return tasks;
+}
+
+// Spool directory, from which task files are claimed by renaming them to <name>.task.<pid>.running.
+// The rename succeeds for exactly one process, such that several processes can watch the same directory.
+// Processed task files are renamed to <name>.task.done or <name>.task.failed.
+class SpoolDirectory
+{
+  public:
+    SpoolDirectory(const std::string& directory, unsigned int idle_timeout) : directory_(directory), idle_timeout_(idle_timeout)
+    {
+        if(!boost::filesystem::is_directory(directory_)) throw std::runtime_error("Spool directory " + directory + " does not exist.");
+    }
+
+    // Claims the next task file in alphabetical order. Returns false if the directory contains a STOP file
+    // or no task file arrived within the idle timeout.
+    bool next(std::string& claimed)
+    {
+        const auto idle_start = std::chrono::steady_clock::now();
+        while(!boost::filesystem::exists(directory_ / "STOP"))
+        {
+            std::vector<boost::filesystem::path> task_files;
+            for(const auto& entry : boost::filesystem::directory_iterator(directory_))
+            {
+                if(entry.path().extension() == ".task") task_files.push_back(entry.path());
+            }
+            std::sort(task_files.begin(), task_files.end());
+            for(const auto& task_file : task_files)
+            {
+                const std::string running = task_file.string() + "." + std::to_string(getpid()) + ".running";
+                boost::system::error_code error;
+                boost::filesystem::rename(task_file, running, error);
+                if(!error)
+                {
+                    claimed = running;
+                    return true;
+                }
+            }
+            if(seconds_since(idle_start) >= idle_timeout_) break;
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+        }
+        return false;
+    }
+
+    // Marks a claimed task file as processed
+    void finish(const std::string& claimed, bool success)
+    {
+        const std::string suffix = "." + std::to_string(getpid()) + ".running";
+        const std::string task_file = claimed.substr(0, claimed.size() - suffix.size());
+        boost::filesystem::rename(claimed, task_file + (success ? ".done" : ".failed"));
+    }
+
+  private:
+    boost::filesystem::path directory_;
+    unsigned int idle_timeout_;
+};
+
+// Runs the producers on all tasks of the task file or the spool directory, with the output files of each task
+// given by outputnames. A failing task is reported and the remaining tasks are processed.
+// Returns the number of failed tasks.
+inline size_t run_task_queue(const std::vector<FriendProducer*>& producers, std::function<std::vector<std::string>(const ProducerTask&)> outputnames,
+                             const TaskQueueSettings& settings, const std::string& tree, unsigned int block_size = 1000, const WriterSettings& writer_settings = WriterSettings(),
+                             const ReaderSettings& reader_settings = ReaderSettings(), const PipelineSettings& pipeline_settings = PipelineSettings())
+{
+    InputFiles input_files(settings.open_files);
+    size_t processed = 0;
+    size_t failed = 0;
+    auto run_tasks = [&](const std::vector<ProducerTask>& tasks) {
+        bool success = true;
+        for(const auto& task : tasks)
+        {
+            try
+            {
+                run_producers(producers, outputnames(task), task, block_size, writer_settings, reader_settings, pipeline_settings, &input_files);
+            }
+            catch(const std::exception& error)
+            {
+                std::cerr << "Task " << task.input << " " << task.folder << " " << task.first_entry << " " << task.last_entry << " failed: " << error.what() << std::endl;
+                failed++;
+                success = false;
+            }
+            input_files.release();
+            processed++;
+        }
+        return success;
+    };
+
+    if(settings.task_file != "")
+    {
+        run_tasks(read_tasks(settings.task_file, tree));
+    }
+    if(settings.spool_dir != "")
+    {
+        SpoolDirectory spool(settings.spool_dir, settings.idle_timeout);
+        std::string claimed;
+        while(spool.next(claimed))
+        {
+            bool success = false;
+            try
+            {
+                success = run_tasks(read_tasks(claimed, tree));
+            }
+            catch(const std::exception& error)
+            {
+                std::cerr << error.what() << std::endl;
+                failed++;
+            }
+            spool.finish(claimed, success);
+        }
+    }
+    std::cout << "Processed " << processed << " tasks, " << failed << " failed" << std::endl;
+    return failed;
+}
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef FRIEND_TREE_PRODUCER_WEIGHTMAP_H
+#define FRIEND_TREE_PRODUCER_WEIGHTMAP_H
+
+#include "TAxis.h"
+#include "TH1.h"
+
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Binning of one axis of a weight map. Bins are numbered as in ROOT: 0 is the underflow bin,
+// 1 to n are the regular bins and n + 1 is the overflow bin.
+class WeightAxis
+{
+  public:
+    WeightAxis(const TAxis& axis, bool clamp_overflow)
+        : n_bins_(axis.GetNbins()), uniform_(!axis.IsVariableBinSize()), xmin_(axis.GetXmin()), xmax_(axis.GetXmax()), clamp_overflow_(clamp_overflow)
+    {
+        // Bin edges, padded to a power of two such that the binary search needs no bounds checks
+        for(int bin = 1; bin <= n_bins_ + 1; bin++) edges_.push_back(axis.GetBinLowEdge(bin));
+        search_size_ = 1;
+        while(search_size_ < edges_.size()) search_size_ *= 2;
+        edges_.resize(search_size_, std::numeric_limits<double>::infinity());
+    }
+
+    int n_bins() const { return n_bins_; }
+
+    // Bin numbers of a block of values
+    void find_bins(const std::vector<Float_t>& values, std::vector<int>& bins) const
+    {
+        bins.resize(values.size());
+        if(uniform_)
+        {
+            // Same arithmetic as TAxis::FindFixBin, such that values on the bin edges end up in the same bins
+            const double width = xmax_ - xmin_;
+            for(size_t k = 0; k < values.size(); k++)
+            {
+                const double x = values[k];
+                const double clamped = (x >= xmin_ && x <= xmax_) ? x : xmin_;
+                const int bin = 1 + int(n_bins_ * (clamped - xmin_) / width);
+                bins[k] = x < xmin_ ? 0 : (x >= xmax_ ? n_bins_ + 1 : bin);
+            }
+        }
+        else
+        {
+            // Branchless binary search for the last edge <= x, with a fixed number of steps for all values
+            const double* edges = edges_.data();
+            for(size_t k = 0; k < values.size(); k++)
+            {
+                const double x = values[k];
+                size_t base = 0;
+                for(size_t half = search_size_ / 2; half > 0; half /= 2) base = (edges[base + half] <= x) ? base + half : base;
+                bins[k] = x < xmin_ ? 0 : int(base) + 1;
+            }
+        }
+        if(clamp_overflow_)
+        {
+            for(auto& bin : bins) bin = bin > n_bins_ ? n_bins_ : bin;
+        }
+    }
+
+  private:
+    int n_bins_;
+    bool uniform_;
+    double xmin_, xmax_;
+    bool clamp_overflow_;
+    std::vector<double> edges_;
+    size_t search_size_;
+};
+
+// Correction map of up to three dimensions, compiled from a TH1, TH2 or TH3 into a flat array of bin contents
+// in the ROOT global bin layout, including the under- and overflow bins.
+class WeightMap
+{
+  public:
+    WeightMap(const TH1& histogram, bool clamp_overflow) : dimension_(histogram.GetDimension())
+    {
+        axes_.emplace_back(*histogram.GetXaxis(), clamp_overflow);
+        if(dimension_ > 1) axes_.emplace_back(*histogram.GetYaxis(), clamp_overflow);
+        if(dimension_ > 2) axes_.emplace_back(*histogram.GetZaxis(), clamp_overflow);
+        stride_y_ = axes_[0].n_bins() + 2;
+        stride_z_ = dimension_ > 1 ? stride_y_ * (axes_[1].n_bins() + 2) : stride_y_;
+        const int n_cells = dimension_ > 2 ? stride_z_ * (axes_[2].n_bins() + 2) : stride_z_;
+        contents_.resize(n_cells);
+        for(int bin = 0; bin < n_cells; bin++) contents_[bin] = histogram.GetBinContent(bin);
+    }
+
+    size_t dimension() const { return dimension_; }
+
+    // Evaluates the map for a block of values, with one column of values per dimension
+    void evaluate(const std::vector<const std::vector<Float_t>*>& values, std::vector<Float_t>& weights)
+    {
+        if(values.size() != dimension_) throw std::runtime_error("Weight map of dimension " + std::to_string(dimension_) + " evaluated with " + std::to_string(values.size()) + " variables.");
+        const size_t size = values[0]->size();
+        axes_[0].find_bins(*values[0], global_bins_);
+        for(size_t axis = 1; axis < dimension_; axis++)
+        {
+            axes_[axis].find_bins(*values[axis], bins_);
+            const int stride = axis == 1 ? stride_y_ : stride_z_;
+            for(size_t k = 0; k < size; k++) global_bins_[k] += stride * bins_[k];
+        }
+        weights.resize(size);
+        for(size_t k = 0; k < size; k++) weights[k] = contents_[global_bins_[k]];
+    }
+
+  private:
+    size_t dimension_;
+    std::vector<WeightAxis> axes_;
+    int stride_y_, stride_z_;
+    std::vector<Float_t> contents_;
+    std::vector<int> global_bins_, bins_;
+};
+
+#endif
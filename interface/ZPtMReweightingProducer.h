@@ -0,0 +1,33 @@
+#ifndef FRIEND_TREE_PRODUCER_ZPTMREWEIGHTINGPRODUCER_H
+#define FRIEND_TREE_PRODUCER_ZPTMREWEIGHTINGPRODUCER_H
+
+#include "HiggsAnalysis/friend-tree-producer/interface/CorrectionWeightsProducer.h"
+
+// Z(pt,mass) reweighting of Drell-Yan samples, based on the generator boson mass and pt.
+// The weight histograms are loaded once per year for all tasks of the producer.
+class ZPtMReweightingProducer : public CorrectionWeightsProducer
+{
+  public:
+    ZPtMReweightingProducer(const std::string& datasets, const std::string& weight_directory)
+        : CorrectionWeightsProducer({zptmass_weight()}, datasets, weight_directory, "ZPtMReweighting", "Z(Pt,Mass) weight friend tree")
+    {
+    }
+
+  private:
+    static CorrectionWeight zptmass_weight()
+    {
+        CorrectionWeight weight;
+        weight.name = "zPtMassWeightKIT";
+        weight.file = "zpt_weights_{year}_kit.root";
+        weight.histogram = "zptmass_histo";
+        weight.variables = {"genbosonmass", "genbosonpt"};
+        // Mass and pt beyond the histogram range use the last bin
+        weight.clamp_overflow = true;
+        // No reweighting for events with mass < 50.0 GeV
+        weight.default_weight = 1.0;
+        weight.minimum = {{"genbosonmass", 50.0}};
+        return weight;
+    }
+};
+
+#endif
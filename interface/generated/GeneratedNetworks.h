@@ -0,0 +1,6 @@
+// Generated by scripts/generate_network_kernels.py. Do not edit.
+// Includes all generated network kernels, which register themselves by name.
+#ifndef FRIEND_TREE_PRODUCER_GENERATED_GENERATEDNETWORKS_H
+#define FRIEND_TREE_PRODUCER_GENERATED_GENERATEDNETWORKS_H
+
+#endif
@@ -0,0 +1,242 @@
+#!/usr/bin/env python
+
+import argparse
+import glob
+import json
+import os
+import re
+
+# Generates C++ kernels for lwtnn networks of fixed topology. The weights are written as constant arrays
+# and the layers are instantiated with their dimensions and activation functions, such that the compiler
+# can unroll and vectorize them. The generated headers register the kernels by name, to be selected by the
+# producers with --generated_kernels after recompilation.
+
+header_template = '''// Generated by scripts/generate_network_kernels.py from {SOURCE}. Do not edit.
+#ifndef FRIEND_TREE_PRODUCER_GENERATED_{GUARD}_H
+#define FRIEND_TREE_PRODUCER_GENERATED_{GUARD}_H
+
+#include "HiggsAnalysis/friend-tree-producer/interface/NetworkKernels.h"
+
+namespace generated_{NAME}
+{{
+{ARRAYS}
+
+inline void compute_event(const double* inputs, double* outputs)
+{{
+{BODY}
+}}
+
+const bool registered = register_generated_kernel("{NAME}", {{"{SOURCE}", "{OUTPUT_NODE}", {{{INPUT_NAMES}}}, {{{OUTPUT_LABELS}}}, compute_event}});
+}}
+
+#endif
+'''
+
+index_template = '''// Generated by scripts/generate_network_kernels.py. Do not edit.
+// Includes all generated network kernels, which register themselves by name.
+#ifndef FRIEND_TREE_PRODUCER_GENERATED_GENERATEDNETWORKS_H
+#define FRIEND_TREE_PRODUCER_GENERATED_GENERATEDNETWORKS_H
+{INCLUDES}
+#endif
+'''
+
+activations = {
+    "linear" : "Linear",
+    "sigmoid" : "Sigmoid",
+    "rectified" : "Rectified",
+    "tanh" : "Tanh",
+    "hard_sigmoid" : "HardSigmoid",
+    "elu" : "ELU",
+    "leakyrelu" : "LeakyReLU",
+    "swish" : "Swish",
+    "softmax" : "Softmax",
+}
+
+def parse_activation(activation):
+    # Depending on the lwtnn version, the activation is given as string or with parameters
+    if isinstance(activation, dict):
+        function = activation["function"]
+        alpha = activation.get("alpha", 1.0 if function == "elu" else 0.3)
+    else:
+        function = activation
+        alpha = 1.0 if function == "elu" else 0.3
+    if function not in activations:
+        raise Exception("Activation function %s not supported by the generated kernels."%function)
+    return activations[function], float(alpha)
+
+def format_values(values):
+    return "{" + ", ".join([repr(float(v)) for v in values]) + "}"
+
+def cpp_string(value):
+    return '"' + value.replace('\\', '\\\\').replace('"', '\\"') + '"'
+
+class KernelWriter(object):
+    def __init__(self):
+        self.arrays = []
+        self.body = []
+        self.n_layers = 0
+
+    def add_layer(self, layer, n_inputs, source):
+        # Appends a layer to the kernel, reading from the array source, and returns the output array and its size
+        function, alpha = parse_activation(layer["activation"])
+        weights, bias = layer["weights"], layer["bias"]
+        index = self.n_layers
+        self.n_layers += 1
+        if layer["architecture"] == "dense":
+            n_outputs = len(bias)
+            if n_outputs * n_inputs != len(weights):
+                raise Exception("Inconsistent dense layer in lwtnn configuration.")
+            rows = [format_values(weights[o*n_inputs:(o+1)*n_inputs]) for o in range(n_outputs)]
+            self.arrays.append("constexpr double weights_%i[%i][%i] = {\n    %s};"%(index, n_outputs, n_inputs, ",\n    ".join(rows)))
+            call = "dense_layer<%i, %i, KernelActivation::%s>"%(n_inputs, n_outputs, function)
+        elif layer["architecture"] == "normalization":
+            n_outputs = n_inputs
+            if len(weights) != n_inputs or len(bias) != n_inputs:
+                raise Exception("Inconsistent normalization layer in lwtnn configuration.")
+            self.arrays.append("constexpr double weights_%i[%i] = %s;"%(index, n_outputs, format_values(weights)))
+            call = "normalization_layer<%i, KernelActivation::%s>"%(n_outputs, function)
+        else:
+            raise Exception("Only dense and normalization layers are supported by the generated kernels.")
+        self.arrays.append("constexpr double bias_%i[%i] = %s;"%(index, n_outputs, format_values(bias)))
+        self.body.append("    double layer_%i[%i];"%(index, n_outputs))
+        self.body.append("    %s(weights_%i, bias_%i, %s, %s, layer_%i);"%(call, index, index, repr(alpha), source, index))
+        return "layer_%i"%index, n_outputs
+
+    def add_inputs(self, variables):
+        n_inputs = len(variables)
+        self.arrays.append("constexpr double input_offsets[%i] = %s;"%(n_inputs, format_values([v["offset"] for v in variables])))
+        self.arrays.append("constexpr double input_scales[%i] = %s;"%(n_inputs, format_values([v["scale"] for v in variables])))
+        self.body.append("    double scaled[%i];"%n_inputs)
+        self.body.append("    for(size_t i = 0; i < %i; i++) scaled[i] = (inputs[i] + input_offsets[i]) * input_scales[i];"%n_inputs)
+
+    def add_output(self, source, n_outputs):
+        self.body.append("    for(size_t o = 0; o < %i; o++) outputs[o] = %s[o];"%(n_outputs, source))
+
+def generate_sequential(config, writer):
+    writer.add_inputs(config["inputs"])
+    source, size = "scaled", len(config["inputs"])
+    for layer in config["layers"]:
+        source, size = writer.add_layer(layer, size, source)
+    if size != len(config["outputs"]):
+        raise Exception("Number of output labels does not match the lwtnn network.")
+    writer.add_output(source, size)
+    return [v["name"] for v in config["inputs"]], config["outputs"]
+
+def generate_graph(config, output_node, writer):
+    if output_node not in config["outputs"]:
+        raise Exception("Output node %s not found in lwtnn graph."%output_node)
+    # The inputs of all input nodes are concatenated, as for DenseNetwork
+    variables, input_offsets = [], []
+    for input_node in config["inputs"]:
+        input_offsets.append(len(variables))
+        variables += input_node["variables"]
+    writer.add_inputs(variables)
+
+    # Only the nodes needed for the output node are evaluated, each once
+    evaluated = {}
+    def evaluate(index):
+        if index in evaluated:
+            return evaluated[index]
+        node = config["nodes"][index]
+        if node["type"] == "input":
+            input_number = node["sources"][0]
+            writer.body.append("    const double* input_%i = scaled + %i;"%(index, input_offsets[input_number]))
+            result = ("input_%i"%index, len(config["inputs"][input_number]["variables"]))
+        elif node["type"] == "feed_forward":
+            source, size = evaluate(node["sources"][0])
+            result = writer.add_layer(config["layers"][node["layer_index"]], size, source)
+        elif node["type"] == "concatenate":
+            sources = [evaluate(s) for s in node["sources"]]
+            size = sum([s[1] for s in sources])
+            name = "concatenate_%i"%index
+            writer.body.append("    double %s[%i];"%(name, size))
+            offset = 0
+            for source, source_size in sources:
+                writer.body.append("    for(size_t i = 0; i < %i; i++) %s[%i + i] = %s[i];"%(source_size, name, offset, source))
+                offset += source_size
+            result = (name, size)
+        else:
+            raise Exception("Only input, feed-forward and concatenation nodes are supported by the generated kernels.")
+        evaluated[index] = result
+        return result
+
+    output = config["outputs"][output_node]
+    source, size = evaluate(output["node_index"])
+    if size != len(output["labels"]):
+        raise Exception("Number of output labels does not match the output node %s."%output_node)
+    writer.add_output(source, size)
+    return [v["name"] for v in variables], output["labels"]
+
+def generate_kernel(name, lwtnn_json, output_node, output_dir):
+    config = json.load(open(lwtnn_json, "r"))
+    writer = KernelWriter()
+    if "nodes" in config:
+        if output_node == "" and len(config["outputs"]) == 1:
+            output_node = config["outputs"].keys()[0]
+        if output_node == "":
+            raise Exception("%s has several output nodes, please give the output node to be used."%lwtnn_json)
+        input_names, output_labels = generate_graph(config, output_node, writer)
+    else:
+        input_names, output_labels = generate_sequential(config, writer)
+
+    header = header_template.format(
+        SOURCE=os.path.abspath(lwtnn_json).replace('\\', '/').replace('"', ''),
+        GUARD=name.upper(),
+        NAME=name,
+        OUTPUT_NODE=output_node,
+        ARRAYS="\n".join(writer.arrays),
+        BODY="\n".join(writer.body),
+        INPUT_NAMES=", ".join([cpp_string(n) for n in input_names]),
+        OUTPUT_LABELS=", ".join([cpp_string(l) for l in output_labels]))
+    header_path = os.path.join(output_dir, name + ".h")
+    with open(header_path, "w") as f:
+        f.write(header)
+    print "Generated kernel %s from %s (%i inputs, %i outputs, %i layers) into %s"%(name, lwtnn_json, len(input_names), len(output_labels), writer.n_layers, header_path)
+
+def write_index(output_dir):
+    # Includes all generated headers of the output directory, such that the kernels are registered
+    headers = sorted([os.path.basename(h) for h in glob.glob(os.path.join(output_dir, "*.h")) if os.path.basename(h) != "GeneratedNetworks.h"])
+    includes = "".join(['\n#include "HiggsAnalysis/friend-tree-producer/interface/generated/%s"'%h for h in headers])
+    with open(os.path.join(output_dir, "GeneratedNetworks.h"), "w") as f:
+        f.write(index_template.format(INCLUDES=includes + ("\n" if includes else "")))
+
+def nnscore_models(nnscore_directory):
+    # Models of NNScore, expected as <year>/<channel>/fold<fold>_lwtnn.json, with the naming convention of NNScoreProducer
+    models = []
+    for lwtnn_json in sorted(glob.glob(os.path.join(nnscore_directory, "*", "*", "fold*_lwtnn.json"))):
+        channel_directory, filename = os.path.split(lwtnn_json)
+        year_directory, channel = os.path.split(channel_directory)
+        year = os.path.basename(year_directory)
+        fold = re.match("fold(\d+)_lwtnn.json", filename).group(1)
+        models.append(("NNScore_%s_%s_fold%s"%(year, channel, fold), lwtnn_json, "total_softmax_0"))
+    return models
+
+def main():
+    parser = argparse.ArgumentParser(description='Script to generate C++ kernels of fixed topology for lwtnn networks, to be compiled into the producers.')
+    parser.add_argument('--model', nargs='+', default=[], help='Networks to generate kernels for, given as <name>:<lwtnn json>[:<output node>]. The producers expect the names NNMass, NNrecoil and NNScore_<year>_<channel>_fold<fold>.')
+    parser.add_argument('--nnscore_directory', default=None, help='Directory with the NNScore models as <year>/<channel>/fold<fold>_lwtnn.json, to generate kernels for all of them.')
+    parser.add_argument('--output_dir', default=os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "interface", "generated"), help='Directory of the generated headers. [Default: %(default)s]')
+    parser.add_argument('--clean', action='store_true', help='Remove all previously generated kernels from the output directory.')
+
+    args = parser.parse_args()
+    models = []
+    for model in args.model:
+        parts = model.split(":")
+        if len(parts) not in [2, 3] or not re.match("^[A-Za-z_][A-Za-z0-9_]*$", parts[0]):
+            parser.error("Models have to be given as <name>:<lwtnn json>[:<output node>] with a valid C++ identifier as name.")
+        models.append((parts[0], parts[1], parts[2] if len(parts) == 3 else ""))
+    if args.nnscore_directory:
+        models += nnscore_models(args.nnscore_directory)
+
+    if not os.path.exists(args.output_dir):
+        os.makedirs(args.output_dir)
+    if args.clean:
+        for header in glob.glob(os.path.join(args.output_dir, "*.h")):
+            os.remove(header)
+    for name, lwtnn_json, output_node in models:
+        generate_kernel(name, lwtnn_json, output_node, args.output_dir)
+    write_index(args.output_dir)
+    print "Recompile with scram b to make the generated kernels available."
+
+if __name__ == "__main__":
+    main()
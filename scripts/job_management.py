@@ -9,6 +9,8 @@ import numpy as np
 import stat
 import re
 import copy
+import math
+import subprocess
 from multiprocessing import Pool
 
 
@@ -30,23 +32,24 @@ if [ $1 -eq {JOBNUMBER} ]; then
 fi
 '''
 
-def write_trees_to_files(info):
-    nick = info[0]
-    collection_path = info[1]
-    db = info[2]
-    print "Copying trees for %s"%nick
-    nick_path = os.path.join(collection_path,nick)
-    if not os.path.exists(nick_path):
-        os.mkdir(nick_path)
-    outputfile = r.TFile.Open(os.path.join(nick_path,nick+".root"),"recreate")
-    for p in db[nick]["pipelines"]:
-        if db[nick]["pipelines"][p] > 0:
-            outputfile.mkdir(p)
-            outputfile.cd(p)
-            tree = db[nick][p].CloneTree()
-            tree.Write("",r.TObject.kOverwrite)
-            db[nick][p].Reset()
-    outputfile.Close()
+# Executables, which can be run together on a single read of the inputs by the CompositeProducer executable
+composite_executables = ['SVFit', 'MELA', 'NNScore', 'NNMass', 'NNrecoil', 'ZPtMReweighting', 'CorrectionWeights']
+
+def task_name(executables):
+    return "_".join(executables)
+
+def get_workdir_path(executables,custom_workdir_path):
+    if custom_workdir_path:
+        return os.path.join(custom_workdir_path,task_name(executables)+"_workdir")
+    else:
+        return os.path.join(os.environ["CMSSW_BASE"],"src",task_name(executables)+"_workdir")
+
+def get_output_path(workdir_path,executables,executable,nick,filename):
+    # Outputs of the CompositeProducer executable are stored in a separate folder per executable
+    if len(executables) > 1:
+        return os.path.join(workdir_path,executable,nick,filename)
+    else:
+        return os.path.join(workdir_path,nick,filename)
 
 def check_output_files(f):
     valid_file = True
@@ -66,7 +69,115 @@ def check_output_files(f):
             os.remove(f)
     return valid_file
 
-def prepare_jobs(input_ntuples_list, inputs_base_folder, inputs_friends_folders, events_per_job, batch_cluster, executable, walltime, max_jobs_per_batch, custom_workdir_path, restrict_to_channels, restrict_to_shifts):
+def get_job_executable(executables):
+    if len(executables) > 1:
+        return "CompositeProducer --producers " + " ".join(executables)
+    else:
+        return executables[0]
+
+def get_job_commandline(job_executable, job):
+    options = " ".join(["--"+k+" "+str(v) for (k,v) in job.items()])
+    return "{EXEC} {OPTIONS}".format(EXEC=job_executable, OPTIONS=options)
+
+def read_metrics_files(directories):
+    metrics = []
+    for directory in directories:
+        for root, dirs, files in os.walk(directory):
+            for f in files:
+                if f.endswith(".metrics.json"):
+                    with open(os.path.join(root,f),"r") as metrics_file:
+                        metrics.append(json.loads(metrics_file.read()))
+    return metrics
+
+def build_cost_model(metrics):
+    # Cost per event and per job of each executable for each sample and channel. Opening the input and initializing
+    # the outputs is accounted once per job as setup time. The per-job overhead of an executable consists of its own
+    # initialization, its finish() and the final write of its output, which are excluded from the cost per event.
+    # The reading time and the finish time of jobs with several producers are shared evenly.
+    groups = {}
+    for m in metrics:
+        if m["events"] == 0:
+            continue
+        stages = m["stage_seconds"]
+        setup = stages.get("open",0.0) + stages.get("declare",0.0)
+        n_producers = float(len(m["producers"]))
+        finish = stages.get("finish",0.0)/n_producers
+        write = stages.get("write",0.0)
+        if len(m["producers"]) == 1:
+            per_event = max(0.0, stages.get("total",0.0) - setup - finish - write)/float(m["events"])
+        else:
+            per_event = ((stages.get("read",0.0) + stages.get("select",0.0))/n_producers + stages.get("compute",0.0) + stages.get("fill",0.0))/float(m["events"])
+        overhead = m["init_seconds"].get(m["producer"],0.0) + finish + write
+        groups.setdefault((m["producer"], m["sample"], m["channel"]),[]).append((m["events"], per_event, overhead, setup, m["peak_rss_kb"]))
+    cost_model = {}
+    for key in groups:
+        events = sum([g[0] for g in groups[key]])
+        cost_model[key] = {
+            "seconds_per_event" : sum([g[0]*g[1] for g in groups[key]])/float(events),
+            "overhead_seconds" : max([g[2] for g in groups[key]]),
+            "setup_seconds" : max([g[3] for g in groups[key]]),
+            "peak_rss_kb" : max([g[4] for g in groups[key]]),
+            }
+    return cost_model
+
+def lookup_cost(cost_model, executable, sample, channel):
+    # Falls back to the average over the samples of the channel, and then over all samples and channels
+    for matches in [[k for k in cost_model if k == (executable, sample, channel)],
+                    [k for k in cost_model if k[0] == executable and k[2] == channel],
+                    [k for k in cost_model if k[0] == executable]]:
+        if len(matches) > 0:
+            return {
+                "seconds_per_event" : sum([cost_model[k]["seconds_per_event"] for k in matches])/float(len(matches)),
+                "overhead_seconds" : max([cost_model[k]["overhead_seconds"] for k in matches]),
+                "setup_seconds" : max([cost_model[k]["setup_seconds"] for k in matches]),
+                "peak_rss_kb" : max([cost_model[k]["peak_rss_kb"] for k in matches]),
+                }
+    return None
+
+def run_probe(info):
+    job_executable = info[0]
+    probe_path = info[1]
+    executables = info[2]
+    job = info[3]
+    nick = job["input"].split("/")[-1].replace(".root","")
+    print "Probing %s on %d entries of %s in %s"%(task_name(executables),job["last_entry"]+1,nick,job["folder"])
+    with open(os.devnull,"w") as devnull:
+        returncode = subprocess.call(get_job_commandline(job_executable, job), shell=True, cwd=probe_path, stdout=devnull, stderr=subprocess.STDOUT)
+    if returncode != 0:
+        print "\tWarning: probe of %s in %s failed with exit code %d"%(nick,job["folder"],returncode)
+        return []
+    filename = "_".join([nick,job["folder"],str(job["first_entry"]),str(job["last_entry"])])+".root"
+    metrics = []
+    for executable in executables:
+        metrics_path = get_metrics_path(get_output_path(probe_path,executables,executable,nick,filename))
+        if os.path.exists(metrics_path):
+            with open(metrics_path,"r") as metrics_file:
+                metrics.append(json.loads(metrics_file.read()))
+    return metrics
+
+def probe_cost_model(ntuple_database, inputs_base_folder, inputs_friends_folders, executables, workdir_path, probe_events, cores):
+    # Runs the executables on the first entries of one pipeline per sample and channel, preferring the nominal one
+    probe_path = os.path.join(workdir_path,"probe")
+    if not os.path.exists(probe_path):
+        os.makedirs(probe_path)
+    probe_jobs = []
+    for nick in sorted(ntuple_database):
+        pipelines = ntuple_database[nick]["pipelines"]
+        for channel in sorted(set([p.split("_")[0] for p in pipelines])):
+            candidates = sorted([p for p in pipelines if p.split("_")[0] == channel and pipelines[p] > 0], key=lambda p: (p != channel+"_nominal", p))
+            if len(candidates) == 0:
+                continue
+            p = candidates[0]
+            job = {"input" : ntuple_database[nick]["path"], "folder" : p, "tree" : "ntuple", "first_entry" : 0, "last_entry" : min(probe_events,pipelines[p])-1}
+            if channel in inputs_friends_folders.keys() and len(inputs_friends_folders[channel])>0:
+                job["input_friends"] = " ".join([job["input"].replace(inputs_base_folder, friend_folder) for friend_folder in inputs_friends_folders[channel]])
+            probe_jobs.append(job)
+    pool = Pool(cores)
+    results = pool.map(run_probe, zip([get_job_executable(executables)]*len(probe_jobs), [probe_path]*len(probe_jobs), [executables]*len(probe_jobs), probe_jobs))
+    pool.close()
+    return [m for metrics in results for m in metrics]
+
+def prepare_jobs(input_ntuples_list, inputs_base_folder, inputs_friends_folders, events_per_job, batch_cluster, executables, walltime, max_jobs_per_batch, custom_workdir_path, restrict_to_channels, restrict_to_shifts, target_runtime=-1, cost_from_metrics=[], probe_events=1000, cores=5, safety_factor=1.5):
     ntuple_database = {}
     for f in input_ntuples_list:
         restrict_to_channels_file = copy.deepcopy(restrict_to_channels)
@@ -95,13 +206,42 @@ def prepare_jobs(input_ntuples_list, inputs_base_folder, inputs_friends_folders,
         ntuple_database[nick]["pipelines"] = {}
         for p in pipelines:
             ntuple_database[nick]["pipelines"][p] = F.Get(p).Get("ntuple").GetEntries()
+    workdir_path = get_workdir_path(executables,custom_workdir_path)
+    if not os.path.exists(workdir_path):
+        os.mkdir(workdir_path)
+
+    # Cost model from recorded job metrics or from probing the executables, used to size the jobs to the target runtime
+    cost_model = {}
+    if target_runtime > 0:
+        if len(cost_from_metrics) > 0:
+            cost_model = build_cost_model(read_metrics_files(cost_from_metrics))
+        else:
+            cost_model = build_cost_model(probe_cost_model(ntuple_database, inputs_base_folder, inputs_friends_folders, executables, workdir_path, probe_events, cores))
+        if len(cost_model) == 0:
+            print "Warning: no job metrics available, using %d events per job."%events_per_job
+    job_costs = {}
+
     job_database = {}
     job_number = 0
     for nick in ntuple_database:
         for p in ntuple_database[nick]["pipelines"]:
             n_entries = ntuple_database[nick]["pipelines"][p]
             if n_entries > 0:
-                entry_list = np.append(np.arange(0,n_entries,events_per_job),[n_entries])
+                # Sum of the costs of all executables, with --events_per_job as upper limit of the events per job
+                costs = [lookup_cost(cost_model, e, nick, p.split("_")[0]) for e in executables]
+                job_events = events_per_job
+                if len(cost_model) > 0 and all(costs):
+                    # The input is opened once per job, also for several executables
+                    seconds_per_event = sum([c["seconds_per_event"] for c in costs])
+                    overhead_seconds = max([c["setup_seconds"] for c in costs]) + sum([c["overhead_seconds"] for c in costs])
+                    peak_rss_kb = max([c["peak_rss_kb"] for c in costs])
+                    if overhead_seconds >= target_runtime:
+                        print "Warning: overhead of %.0f s per job for %s in %s exceeds the target runtime, using %d events per job."%(overhead_seconds,nick,p,events_per_job)
+                    elif seconds_per_event > 0:
+                        job_events = int(max(1, min(events_per_job, (target_runtime - overhead_seconds)/seconds_per_event)))
+                elif len(cost_model) > 0:
+                    print "Warning: no job metrics for %s in %s, using %d events per job."%(nick,p,events_per_job)
+                entry_list = np.append(np.arange(0,n_entries,job_events),[n_entries])
                 first_entries = entry_list[:-1]
                 last_entries = entry_list[1:] -1
                 for first,last in zip(first_entries, last_entries):
@@ -111,24 +251,21 @@ def prepare_jobs(input_ntuples_list, inputs_base_folder, inputs_friends_folders,
                     job_database[job_number]["tree"] = "ntuple"
                     job_database[job_number]["first_entry"] = first
                     job_database[job_number]["last_entry"] = last
+                    if len(cost_model) > 0 and all(costs):
+                        job_costs[job_number] = {"runtime" : overhead_seconds + (last-first+1)*seconds_per_event, "peak_rss_kb" : peak_rss_kb}
                     channel = p.split("_")[0]
                     if channel in inputs_friends_folders.keys() and len(inputs_friends_folders[channel])>0:
                         job_database[job_number]["input_friends"] = " ".join([job_database[job_number]["input"].replace(inputs_base_folder, friend_folder) for friend_folder in inputs_friends_folders[channel]])
                     job_number +=1
             else:
                 print "Warning: %s has no entries in pipeline %s"%(nick,p)
-    if custom_workdir_path:
-        workdir_path = os.path.join(custom_workdir_path,executable+"_workdir")
-    else:
-        workdir_path = os.path.join(os.environ["CMSSW_BASE"],"src",executable+"_workdir")
-    if not os.path.exists(workdir_path):
-        os.mkdir(workdir_path)
+    executable = task_name(executables)
+    job_executable = get_job_executable(executables)
     if not os.path.exists(os.path.join(workdir_path,"logging")):
         os.mkdir(os.path.join(workdir_path,"logging"))
     commandlist = []
     for jobnumber in job_database:
-        options = " ".join(["--"+k+" "+str(v) for (k,v) in job_database[jobnumber].items()])
-        commandline = "{EXEC} {OPTIONS}".format(EXEC=executable, OPTIONS=options)
+        commandline = get_job_commandline(job_executable, job_database[jobnumber])
         command = command_template.format(JOBNUMBER=str(jobnumber), COMMAND=commandline)
         commandlist.append(command)
     commands = "\n".join(commandlist)
@@ -136,6 +273,7 @@ def prepare_jobs(input_ntuples_list, inputs_base_folder, inputs_friends_folders,
     executable_path = os.path.join(workdir_path,"condor_"+executable+".sh")
     jobdb_path = os.path.join(workdir_path,"condor_"+executable+".json")
     datasetdb_path = os.path.join(workdir_path,"dataset.json")
+    costdb_path = os.path.join(workdir_path,"job_costs.json")
     with open(executable_path,"w") as shellscript:
         shellscript.write(shellscript_content)
         os.chmod(executable_path, os.stat(executable_path).st_mode | stat.S_IEXEC)
@@ -157,14 +295,27 @@ def prepare_jobs(input_ntuples_list, inputs_base_folder, inputs_friends_folders,
             arguments_file.write("\n".join([str(arg) for arg in argument_list]))
             arguments_file.close()
         njobs = "arguments from arguments_%d.txt"%(index)
+        # Walltime and memory from the predicted runtime and peak memory of the jobs in the batch, if not given explicitly.
+        # Without predicted costs, no memory request is made.
+        batch_costs = [job_costs[j] for j in argument_list if j in job_costs]
+        batch_walltime = walltime
+        requests = []
+        if len(batch_costs) > 0:
+            if walltime <= 0:
+                batch_walltime = int(math.ceil(safety_factor*max([c["runtime"] for c in batch_costs])/60.0))*60
+            memory = int(math.ceil(safety_factor*max([c["peak_rss_kb"] for c in batch_costs])/1024.0))
+            requests.append("RequestMemory = %d"%memory)
+            print "Batch %d: walltime %d s, memory %d MB"%(index,batch_walltime,memory)
         if batch_cluster in  ["etp6","etp7","lxplus6","lxplus7"]:
-            if walltime > 0:
-                condorjdl_content = condorjdl_template.format(TASKDIR=workdir_path,TASKNUMBER=str(index),EXECUTABLE=executable_path,NJOBS=njobs,WALLTIME=str(walltime))
+            if batch_walltime > 0:
+                condorjdl_content = condorjdl_template.format(TASKDIR=workdir_path,TASKNUMBER=str(index),EXECUTABLE=executable_path,NJOBS=njobs,WALLTIME=str(batch_walltime),REQUESTS="\n".join(requests))
             else:
                 print "Warning: walltime for %s cluster not set. Setting it to 1h."%batch_cluster
-                condorjdl_content = condorjdl_template.format(TASKDIR=workdir_path,TASKNUMBER=str(index),EXECUTABLE=executable_path,NJOBS=njobs,WALLTIME=str(3600))
+                condorjdl_content = condorjdl_template.format(TASKDIR=workdir_path,TASKNUMBER=str(index),EXECUTABLE=executable_path,NJOBS=njobs,WALLTIME=str(3600),REQUESTS="\n".join(requests))
         else:
-            condorjdl_content = condorjdl_template.format(TASKDIR=workdir_path,TASKNUMBER=str(index),EXECUTABLE=executable_path,NJOBS=njobs)
+            if len(batch_costs) > 0 and batch_walltime > 0:
+                requests.insert(0,"+RequestRuntime = %d"%batch_walltime)
+            condorjdl_content = condorjdl_template.format(TASKDIR=workdir_path,TASKNUMBER=str(index),EXECUTABLE=executable_path,NJOBS=njobs,REQUESTS="\n".join(requests))
         with open(condorjdl_path,"w") as condorjdl:
             condorjdl.write(condorjdl_content)
             condorjdl.close()
@@ -181,40 +332,46 @@ def prepare_jobs(input_ntuples_list, inputs_base_folder, inputs_friends_folders,
     with open(datasetdb_path,"w") as datasets:
         datasets.write(json.dumps(ntuple_database, sort_keys=True, indent=2))
         datasets.close()
+    if len(job_costs) > 0:
+        with open(costdb_path,"w") as costs:
+            costs.write(json.dumps(job_costs, sort_keys=True, indent=2))
+            costs.close()
 
-def collect_outputs(executable,cores,custom_workdir_path):
-    if custom_workdir_path:
-        workdir_path = os.path.join(custom_workdir_path,executable+"_workdir")
-    else:
-        workdir_path = os.path.join(os.environ["CMSSW_BASE"],"src",executable+"_workdir")
-    jobdb_path = os.path.join(workdir_path,"condor_"+executable+".json")
-    datasetdb_path = os.path.join(workdir_path,"dataset.json")
+def collect_outputs(executables,cores,custom_workdir_path):
+    # The job outputs are merged per sample by the MergeFriendTrees executable, which copies the compressed baskets of the chunks
+    workdir_path = get_workdir_path(executables,custom_workdir_path)
+    jobdb_path = os.path.join(workdir_path,"condor_"+task_name(executables)+".json")
     jobdb_file = open(jobdb_path,"r")
     jobdb = json.loads(jobdb_file.read())
-    datasetdb_file = open(datasetdb_path,"r")
-    datasetdb = json.loads(datasetdb_file.read())
-    collection_path = os.path.join(workdir_path,executable+"_collected")
-    if not os.path.exists(collection_path):
-        os.mkdir(collection_path)
-    for jobnumber in sorted([int(k) for k in jobdb]):
-        nick = jobdb[str(jobnumber)]["input"].split("/")[-1].replace(".root","")
-        pipeline = jobdb[str(jobnumber)]["folder"]
-        tree = jobdb[str(jobnumber)]["tree"]
-        first = jobdb[str(jobnumber)]["first_entry"]
-        last = jobdb[str(jobnumber)]["last_entry"]
-        filename = "_".join([nick,pipeline,str(first),str(last)])+".root"
-        filepath = os.path.join(workdir_path,nick,filename)
-        datasetdb[nick].setdefault(pipeline,r.TChain("/".join([pipeline,tree]))).Add(filepath)
+    for executable in executables:
+        collection_path = os.path.join(workdir_path,executable+"_collected")
+        if not os.path.exists(collection_path):
+            os.mkdir(collection_path)
+        outputs = {}
+        for jobnumber in sorted([int(k) for k in jobdb]):
+            nick = jobdb[str(jobnumber)]["input"].split("/")[-1].replace(".root","")
+            pipeline = jobdb[str(jobnumber)]["folder"]
+            first = jobdb[str(jobnumber)]["first_entry"]
+            last = jobdb[str(jobnumber)]["last_entry"]
+            filename = "_".join([nick,pipeline,str(first),str(last)])+".root"
+            filepath = get_output_path(workdir_path,executables,executable,nick,filename)
+            outputs.setdefault(nick,{}).setdefault(pipeline,[]).append((first,filepath))
+        merge_config = {"tree" : "ntuple", "outputs" : []}
+        for nick in sorted(outputs):
+            folders = [{"folder" : p, "inputs" : [f for (first,f) in sorted(outputs[nick][p])]} for p in sorted(outputs[nick])]
+            merge_config["outputs"].append({"output" : os.path.join(collection_path,nick,nick+".root"), "folders" : folders})
+        merge_config_path = os.path.join(workdir_path,"collect_"+executable+".json")
+        with open(merge_config_path,"w") as merge_config_file:
+            merge_config_file.write(json.dumps(merge_config, sort_keys=True, indent=2))
+            merge_config_file.close()
+        print "Collecting outputs of %s for %d samples"%(executable,len(outputs))
+        returncode = subprocess.call(["MergeFriendTrees", "--config", merge_config_path, "--threads", str(cores)])
+        if returncode != 0:
+            raise Exception("Collecting the outputs of %s failed. Please run the check command to find the failed jobs."%executable)
 
-    nicks = sorted(datasetdb)
-    pool = Pool(cores)
-    pool.map(write_trees_to_files, zip(nicks,[collection_path]*len(nicks), [datasetdb]*len(nicks)))
-
-def check_and_resubmit(executable,custom_workdir_path):
-    if custom_workdir_path:
-        workdir_path = os.path.join(custom_workdir_path,executable+"_workdir")
-    else:
-        workdir_path = os.path.join(os.environ["CMSSW_BASE"],"src",executable+"_workdir")
+def check_and_resubmit(executables,custom_workdir_path):
+    workdir_path = get_workdir_path(executables,custom_workdir_path)
+    executable = task_name(executables)
     jobdb_path = os.path.join(workdir_path,"condor_"+executable+".json")
     datasetdb_path = os.path.join(workdir_path,"dataset.json")
     jobdb_file = open(jobdb_path,"r")
@@ -230,8 +387,8 @@ def check_and_resubmit(executable,custom_workdir_path):
         first = jobdb[str(jobnumber)]["first_entry"]
         last = jobdb[str(jobnumber)]["last_entry"]
         filename = "_".join([nick,pipeline,str(first),str(last)])+".root"
-        filepath = os.path.join(workdir_path,nick,filename)
-        if not check_output_files(filepath):
+        filepaths = [get_output_path(workdir_path,executables,e,nick,filename) for e in executables]
+        if not all([check_output_files(filepath) for filepath in filepaths]):
             job_to_resubmit.append(jobnumber)
     with open(arguments_path, "w") as arguments_file:
         arguments_file.write("\n".join([str(arg) for arg in job_to_resubmit]))
@@ -252,6 +409,64 @@ def check_and_resubmit(executable,custom_workdir_path):
     print "cd {TASKDIR}; condor_submit {CONDORJDL}".format(TASKDIR=workdir_path, CONDORJDL=condor_jdl_resubmit_path)
 
 
+def get_metrics_path(output_path):
+    return re.sub(r"\.root$", ".metrics.json", output_path)
+
+def print_metrics_table(title, keys, groups):
+    stages = ["open", "declare", "read", "compute", "fill", "write"]
+    header = "".join(["%-40s"%title] + ["%10s"%c for c in ["jobs", "events", "time [s]", "events/s"]] + ["%10s"%("%"+s) for s in stages] + ["%12s"%"read calls", "%12s"%"read [MB]", "%14s"%"max RSS [MB]"])
+    print
+    print header
+    print "-"*len(header)
+    for key in keys:
+        metrics = groups[key]
+        events = sum([m["events"] for m in metrics])
+        total = sum([m["stage_seconds"].get("total",0.0) for m in metrics])
+        fractions = [100.0*sum([m["stage_seconds"].get(s,0.0) for m in metrics])/total if total > 0 else 0.0 for s in stages]
+        read_calls = sum([m.get("read_calls",0) for m in metrics])
+        read_mb = sum([m.get("bytes_read",0) for m in metrics])/1024.0/1024.0
+        rss = max([m["peak_rss_kb"] for m in metrics])/1024.0
+        print "".join(["%-40s"%" ".join(key)] + ["%10d"%len(metrics), "%10d"%events, "%10.1f"%total, "%10.1f"%(events/total if total > 0 else 0.0)] + ["%10.1f"%f for f in fractions] + ["%12d"%read_calls, "%12.1f"%read_mb, "%14.1f"%rss])
+
+def aggregate_metrics(executables,custom_workdir_path):
+    workdir_path = get_workdir_path(executables,custom_workdir_path)
+    jobdb_path = os.path.join(workdir_path,"condor_"+task_name(executables)+".json")
+    jobdb_file = open(jobdb_path,"r")
+    jobdb = json.loads(jobdb_file.read())
+    all_metrics = []
+    missing = 0
+    for jobnumber in sorted([int(k) for k in jobdb]):
+        nick = jobdb[str(jobnumber)]["input"].split("/")[-1].replace(".root","")
+        pipeline = jobdb[str(jobnumber)]["folder"]
+        first = jobdb[str(jobnumber)]["first_entry"]
+        last = jobdb[str(jobnumber)]["last_entry"]
+        filename = "_".join([nick,pipeline,str(first),str(last)])+".root"
+        for executable in executables:
+            metrics_path = get_metrics_path(get_output_path(workdir_path,executables,executable,nick,filename))
+            if not os.path.exists(metrics_path):
+                missing += 1
+                continue
+            with open(metrics_path,"r") as metrics_file:
+                all_metrics.append(json.loads(metrics_file.read()))
+    print "Found metrics of %d outputs, %d outputs without metrics."%(len(all_metrics),missing)
+    if len(all_metrics) == 0:
+        return
+
+    # Throughput tables per executable, per executable and channel, and per executable and sample
+    summary = {}
+    for name, fields in [("executable", ["producer"]), ("channel", ["producer", "channel"]), ("sample", ["producer", "sample"])]:
+        groups = {}
+        for metrics in all_metrics:
+            groups.setdefault(tuple([metrics[f] for f in fields]),[]).append(metrics)
+        keys = sorted(groups)
+        print_metrics_table(" / ".join(fields), keys, groups)
+        summary[name] = [dict(zip(fields, key) + [("jobs", len(groups[key])), ("events", sum([m["events"] for m in groups[key]])), ("seconds", sum([m["stage_seconds"].get("total",0.0) for m in groups[key]]))]) for key in keys]
+    summary_path = os.path.join(workdir_path,"metrics_summary.json")
+    with open(summary_path,"w") as summary_file:
+        summary_file.write(json.dumps(summary, sort_keys=True, indent=2))
+    print
+    print "Summary written to %s"%summary_path
+
 def extract_friend_paths(packed_paths):
     extracted_paths = {
         "em" : [],
@@ -284,14 +499,18 @@ def extract_friend_paths(packed_paths):
 
 def main():
     parser = argparse.ArgumentParser(description='Script to manage condor batch system jobs for the executables and their outputs.')
-    parser.add_argument('--executable',required=True, choices=['SVFit', 'MELA', 'NNScore', 'NNMass', 'NNrecoil', 'FakeFactors', 'ZPtMReweighting'], help='Executable to be used for friend tree creation ob the batch system.')
+    parser.add_argument('--executable',required=True, nargs='+', choices=['SVFit', 'MELA', 'NNScore', 'NNMass', 'NNrecoil', 'FakeFactors', 'ZPtMReweighting', 'CorrectionWeights'], help='Executable to be used for friend tree creation ob the batch system. Several executables out of %s can be given to run them within one job on a single read of the inputs.'%", ".join(composite_executables))
     parser.add_argument('--batch_cluster',required=True, choices=['naf','etp6','etp7','lxplus6','lxplus7'], help='Batch system cluster to be used.')
-    parser.add_argument('--command',required=True, choices=['submit','collect','check'], help='Command to be done by the job manager.')
+    parser.add_argument('--command',required=True, choices=['submit','collect','check','metrics'], help='Command to be done by the job manager. The command metrics aggregates the job metrics written next to the outputs into throughput tables.')
     parser.add_argument('--input_ntuples_directory',required=True, help='Directory where the input files can be found. The file structure in the directory should match */*.root wildcard.')
     parser.add_argument('--friend_ntuples_directories', nargs='+', default=[], help='Directory where the friend files can be found. The file structure in the directory should match the one of the base ntuples. Channel dependent parts of the path can be inserted like /commonpath/{et:et_folder,mt:mt_folder,tt:tt_folder}/commonpath.')
     parser.add_argument('--events_per_job',required=True, type=int, help='Event to be processed by each job')
     parser.add_argument('--walltime',default=-1, type=int, help='Walltime to be set for the job (in seconds). If negative, then it will not be set. [Default: %(default)s]')
-    parser.add_argument('--cores',default=5, type=int, help='Number of cores to be used for the collect command. [Default: %(default)s]')
+    parser.add_argument('--cores',default=5, type=int, help='Number of cores to be used for the collect command and for probing the job costs. [Default: %(default)s]')
+    parser.add_argument('--target_runtime',default=-1, type=int, help='Target runtime of each job (in seconds). If positive, the events of each job are chosen according to the cost per event of the executables for the sample and channel, with --events_per_job as upper limit, and the walltime and memory requests are set accordingly. [Default: %(default)s]')
+    parser.add_argument('--cost_from_metrics', nargs='+', default=[], help='Directories with job metrics of previous runs, e.g. workdirs, to determine the job costs from. If not given, the costs are determined by running the executables on the first entries of each sample and channel.')
+    parser.add_argument('--probe_events',default=1000, type=int, help='Number of entries to run the executables on to determine the job costs. [Default: %(default)s]')
+    parser.add_argument('--safety_factor',default=1.5, type=float, help='Factor on the predicted runtime and memory of the jobs for the walltime and memory requests. [Default: %(default)s]')
     parser.add_argument('--max_jobs_per_batch',default=10000, type=int, help='Maximal number of job per batch. [Default: %(default)s]')
     parser.add_argument('--extended_file_access',default=None, type=str, help='Additional prefix for the file access, e.g. via xrootd.')
     parser.add_argument('--custom_workdir_path',default=None, type=str, help='Absolute path to a workdir directory different from $CMSSW_BASE/src.')
@@ -300,16 +519,20 @@ def main():
     parser.add_argument('--restrict_to_samples_wildcard', default="*", help='Produce friends only for samples matching the path wildcard')
 
     args = parser.parse_args()
+    if len(args.executable) > 1 and not set(args.executable).issubset(composite_executables):
+        parser.error("Only %s can be combined within one job."%", ".join(composite_executables))
 
     input_ntuples_list = glob.glob(os.path.join(args.input_ntuples_directory,args.restrict_to_samples_wildcard,"*.root"))
     extracted_friend_paths = extract_friend_paths(args.friend_ntuples_directories)
     if args.extended_file_access:
         input_ntuples_list = ["/".join([args.extended_file_access,f]) for f in input_ntuples_list]
     if args.command == "submit":
-        prepare_jobs(input_ntuples_list, args.input_ntuples_directory, extracted_friend_paths, args.events_per_job, args.batch_cluster, args.executable, args.walltime, args.max_jobs_per_batch, args.custom_workdir_path, args.restrict_to_channels, args.restrict_to_shifts)
+        prepare_jobs(input_ntuples_list, args.input_ntuples_directory, extracted_friend_paths, args.events_per_job, args.batch_cluster, args.executable, args.walltime, args.max_jobs_per_batch, args.custom_workdir_path, args.restrict_to_channels, args.restrict_to_shifts, args.target_runtime, args.cost_from_metrics, args.probe_events, args.cores, args.safety_factor)
     elif args.command == "collect":
         collect_outputs(args.executable, args.cores, args.custom_workdir_path)
     elif args.command == "check":
         check_and_resubmit(args.executable, args.custom_workdir_path)
+    elif args.command == "metrics":
+        aggregate_metrics(args.executable, args.custom_workdir_path)
 if __name__ == "__main__":
     main()